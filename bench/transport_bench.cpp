@@ -0,0 +1,295 @@
+// compares tcp loopback, unix domain socket and the shared-memory ring:
+// one-way throughput (msgs/s) and ping-pong round trip latency.
+// each run uses a receiver thread and blocking I/O on both ends.
+// the ring is measured twice: "shm-bell" is what clients use (consumer
+// sleeps, producer rings a doorbell byte on the unix socket, replies come
+// back over the socket), "shm-spin" polls the ring both ways as a best case.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+#include <QThread>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QJsonObject>
+#include <QVector>
+#include <functional>
+#include <algorithm>
+#include "MessageFraming.h"
+#include "ShmRing.h"
+
+static const qint64 kSocketBacklog = 1024 * 1024;
+static const int kIoTimeoutMs = 10000;
+static const quint32 kRingBytes = 4 * 1024 * 1024;
+
+enum class Transport { Tcp, Unix, ShmSpin, ShmBell };
+
+// blocking byte channel, used from one thread only
+struct Channel {
+    std::function<void(const QByteArray &)> send;
+    std::function<void()> flush;
+    // waits for some bytes; empty on timeout
+    std::function<QByteArray()> receive;
+};
+
+static Channel socketChannel(QIODevice *dev) {
+    Channel ch;
+    ch.send = [dev](const QByteArray &b) {
+        dev->write(b);
+        if (dev->bytesToWrite() > kSocketBacklog) dev->waitForBytesWritten(kIoTimeoutMs);
+    };
+    ch.flush = [dev] {
+        while (dev->bytesToWrite() > 0 && dev->waitForBytesWritten(kIoTimeoutMs)) {}
+    };
+    ch.receive = [dev] {
+        if (dev->bytesAvailable() == 0) dev->waitForReadyRead(kIoTimeoutMs);
+        return dev->readAll();
+    };
+    return ch;
+}
+
+static void ringWrite(ShmRing *ring, const QByteArray &b, const std::function<void()> &onPublished) {
+    qint64 off = 0;
+    while (off < b.size()) {
+        qint64 n = ring->write(b.constData() + off, b.size() - off);
+        if (n == 0) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        off += n;
+        onPublished();
+    }
+}
+
+// both directions on rings, busy polling; no doorbells
+static Channel ringChannel(ShmRing *out, ShmRing *in) {
+    Channel ch;
+    ch.send = [out](const QByteArray &b) {
+        ringWrite(out, b, [] {});
+    };
+    ch.flush = [] {};
+    ch.receive = [in] {
+        QElapsedTimer t;
+        t.start();
+        for (;;) {
+            QByteArray b;
+            if (!in->read(kSocketBacklog, b)) return QByteArray();
+            if (!b.isEmpty() || t.elapsed() > kIoTimeoutMs) return b;
+            QThread::yieldCurrentThread();
+        }
+    };
+    return ch;
+}
+
+// client side of the shipped transport: frames into the ring, a doorbell
+// byte when the server went to sleep, replies read from the socket
+static Channel bellProducerChannel(ShmRing *ring, QLocalSocket *sock) {
+    Channel ch = socketChannel(sock);
+    ch.send = [ring, sock](const QByteArray &b) {
+        ringWrite(ring, b, [ring, sock] {
+            if (ring->takeSleeper()) {
+                sock->write("\x01", 1);
+                sock->flush();
+            }
+        });
+    };
+    return ch;
+}
+
+// server side, same as ClientConnection::drainRing(): drain, announce
+// sleep, then block on the socket until a doorbell arrives
+static Channel bellConsumerChannel(ShmRing *ring, QLocalSocket *sock) {
+    Channel ch = socketChannel(sock);
+    ch.receive = [ring, sock] {
+        QByteArray b;
+        for (;;) {
+            if (!ring->read(kSocketBacklog, b)) return QByteArray();
+            if (!b.isEmpty()) return b;
+            if (!ring->prepareSleep()) continue;
+            if (sock->bytesAvailable() == 0 && !sock->waitForReadyRead(kIoTimeoutMs)) return QByteArray();
+            sock->readAll();
+        }
+    };
+    return ch;
+}
+
+// receiver side: count frames, optionally echo each one back
+static void serve(Channel &ch, int frames, bool echo) {
+    QByteArray buf, payload;
+    int got = 0;
+    while (got < frames) {
+        QByteArray chunk = ch.receive();
+        if (chunk.isEmpty()) break;
+        buf.append(chunk);
+        while (tryExtractFrame(buf, payload)) {
+            ++got;
+            if (echo) {
+                ch.send(packFrame(payload));
+                ch.flush();
+            }
+        }
+    }
+}
+
+struct Result {
+    double msgsPerSec = 0;
+    QVector<qint64> rttNs;
+};
+
+// sets up a fresh connection for one phase; body runs on the sender side
+// and may call waitReceiver to include the receiver's completion in a timing
+using PhaseBody = std::function<void(Channel &, const std::function<void()> &waitReceiver)>;
+
+static bool runPhase(Transport kind, int frames, bool echo, const PhaseBody &body) {
+    QSemaphore ready;
+    quint16 port = 0;
+    const QString name = QStringLiteral("tt-bench-%1").arg(QCoreApplication::applicationPid());
+
+    QSharedMemory shm(name);
+    ShmRing c2s, s2c;
+    const bool shmKind = kind == Transport::ShmSpin || kind == Transport::ShmBell;
+    if (shmKind) {
+        const qint64 one = ShmRing::bytesNeeded(kRingBytes);
+        if (!shm.create(2 * one)) return false;
+        c2s.init(shm.data(), kRingBytes);
+        s2c.init(static_cast<char*>(shm.data()) + one, kRingBytes);
+    }
+
+    QThread *receiver = QThread::create([&] {
+        if (kind == Transport::Tcp) {
+            QTcpServer srv;
+            srv.listen(QHostAddress::LocalHost, 0);
+            port = srv.serverPort();
+            ready.release();
+            if (!srv.waitForNewConnection(kIoTimeoutMs)) return;
+            QTcpSocket *s = srv.nextPendingConnection();
+            s->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            Channel ch = socketChannel(s);
+            serve(ch, frames, echo);
+        } else if (kind == Transport::Unix || kind == Transport::ShmBell) {
+            QLocalServer srv;
+            QLocalServer::removeServer(name);
+            srv.listen(name);
+            ready.release();
+            if (!srv.waitForNewConnection(kIoTimeoutMs)) return;
+            QLocalSocket *s = srv.nextPendingConnection();
+            Channel ch = kind == Transport::Unix ? socketChannel(s) : bellConsumerChannel(&c2s, s);
+            serve(ch, frames, echo);
+        } else {
+            ready.release();
+            Channel ch = ringChannel(&s2c, &c2s);
+            serve(ch, frames, echo);
+        }
+    });
+    receiver->start();
+    ready.acquire();
+    auto waitReceiver = [receiver] { receiver->wait(); };
+
+    bool ok = true;
+    if (kind == Transport::Tcp) {
+        QTcpSocket s;
+        s.connectToHost(QHostAddress::LocalHost, port);
+        ok = s.waitForConnected(kIoTimeoutMs);
+        s.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        Channel ch = socketChannel(&s);
+        if (ok) body(ch, waitReceiver);
+        receiver->wait();
+    } else if (kind == Transport::Unix || kind == Transport::ShmBell) {
+        QLocalSocket s;
+        s.connectToServer(name);
+        ok = s.waitForConnected(kIoTimeoutMs);
+        Channel ch = kind == Transport::Unix ? socketChannel(&s) : bellProducerChannel(&c2s, &s);
+        if (ok) body(ch, waitReceiver);
+        receiver->wait();
+    } else {
+        Channel ch = ringChannel(&c2s, &s2c);
+        body(ch, waitReceiver);
+        receiver->wait();
+    }
+    delete receiver;
+    return ok;
+}
+
+static Result bench(Transport kind, const QByteArray &frame, int count, int pings) {
+    Result r;
+    runPhase(kind, count, false, [&](Channel &ch, const std::function<void()> &waitReceiver) {
+        QElapsedTimer t;
+        t.start();
+        for (int i = 0; i < count; ++i) ch.send(frame);
+        ch.flush();
+        // done when the last frame has been parsed on the other side
+        waitReceiver();
+        r.msgsPerSec = count / (t.nsecsElapsed() / 1e9);
+    });
+
+    runPhase(kind, pings, true, [&](Channel &ch, const std::function<void()> &) {
+        QByteArray buf, payload;
+        QElapsedTimer t;
+        for (int i = 0; i < pings; ++i) {
+            t.start();
+            ch.send(frame);
+            ch.flush();
+            while (!tryExtractFrame(buf, payload)) {
+                QByteArray chunk = ch.receive();
+                if (chunk.isEmpty()) return;
+                buf.append(chunk);
+            }
+            r.rttNs.append(t.nsecsElapsed());
+        }
+    });
+    std::sort(r.rttNs.begin(), r.rttNs.end());
+    return r;
+}
+
+static double percentileUs(const QVector<qint64> &sorted, double p) {
+    if (sorted.isEmpty()) return 0;
+    int idx = qBound(0, static_cast<int>(p * sorted.size()), static_cast<int>(sorted.size()) - 1);
+    return sorted.at(idx) / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption countOpt("count", "Frames for the throughput run.", "n", "1000000");
+    QCommandLineOption pingsOpt("pings", "Round trips for the latency run.", "n", "20000");
+    QCommandLineOption padOpt("pad", "Extra payload bytes per frame.", "bytes", "0");
+    parser.addOption(countOpt);
+    parser.addOption(pingsOpt);
+    parser.addOption(padOpt);
+    parser.process(a);
+
+    // same shape as a NetworkMetrics sample from the device client
+    QJsonObject obj;
+    obj["type"] = "NetworkMetrics";
+    obj["bandwidth"] = 512.25;
+    obj["latency"] = 12.5;
+    obj["packet_loss"] = 0.01;
+    if (parser.value(padOpt).toInt() > 0) obj["pad"] = QString(parser.value(padOpt).toInt(), 'x');
+    const QByteArray frame = packJson(obj);
+    const int count = parser.value(countOpt).toInt();
+    const int pings = parser.value(pingsOpt).toInt();
+
+    QTextStream out(stdout);
+    out << "frame " << frame.size() << " bytes, " << count << " msgs, " << pings << " pings\n";
+    out << qSetFieldWidth(10) << Qt::left << "transport" << "msgs/s" << "p50 us" << "p99 us"
+        << qSetFieldWidth(0) << "\n";
+    const QList<QPair<Transport, QString>> kinds = {
+        {Transport::Tcp, "tcp"}, {Transport::Unix, "unix"},
+        {Transport::ShmBell, "shm-bell"}, {Transport::ShmSpin, "shm-spin"}};
+    for (const auto &k : kinds) {
+        Result r = bench(k.first, frame, count, pings);
+        out << qSetFieldWidth(10) << Qt::left << k.second
+            << QString::number(r.msgsPerSec, 'f', 0)
+            << QString::number(percentileUs(r.rttNs, 0.50), 'f', 1)
+            << QString::number(percentileUs(r.rttNs, 0.99), 'f', 1)
+            << qSetFieldWidth(0) << "\n";
+        out.flush();
+    }
+    return 0;
+}
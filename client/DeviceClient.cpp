@@ -15,9 +15,20 @@ inline double randRange(double minVal, double maxVal) {
 DeviceClient::DeviceClient(const QString &host, quint16 port, QObject *parent)
     : QObject(parent),
     socket_(new QTcpSocket(this)),
+    localSocket_(nullptr),
     host_(host),
     port_(port),
+    frontHost_(host),
+    frontPort_(port),
+    redirecting_(false),
     started_(false),
+    flushBatchBytes_(0),
+    flushInFlight_(0),
+    shmRingBytes_(0),
+    shmState_(ShmOff),
+    udp_(nullptr),
+    udpPort_(0),
+    udpSeq_(0),
     critLatencyMs_(100),
     critPacketLoss_(0.05)
 {
@@ -27,17 +38,129 @@ DeviceClient::DeviceClient(const QString &host, quint16 port, QObject *parent)
     connect(socket_, &QTcpSocket::connected, this, &DeviceClient::onConnected);
     connect(socket_, &QTcpSocket::readyRead, this, &DeviceClient::onReadyRead);
     connect(socket_, &QTcpSocket::disconnected, this, &DeviceClient::onDisconnected);
+    connect(socket_, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        // a failed connect never reaches onDisconnected
+        if (isOnline() || redirecting_) return;
+        if (host_ != frontHost_ || port_ != frontPort_) {
+            // the shard we were sent to is unreachable, ask the front again
+            qInfo() << "Shard" << host_ << port_ << "unreachable, back to front node";
+            host_ = frontHost_;
+            port_ = frontPort_;
+        }
+        if (!retryTimer_.isActive()) retryTimer_.start();
+    });
 
     connect(&sendTimer_, &QTimer::timeout, this, &DeviceClient::onSendTick);
+    connect(&flushTimer_, &QTimer::timeout, this, &DeviceClient::onFlushTick);
+    flushTimer_.setInterval(50);
+    connect(&shmRetryTimer_, &QTimer::timeout, this, &DeviceClient::flushShmPending);
+    shmRetryTimer_.setSingleShot(true);
+    shmRetryTimer_.setInterval(1);
 
-    tryConnect();
+    // deferred so transport options can be set first
+    QMetaObject::invokeMethod(this, &DeviceClient::tryConnect, Qt::QueuedConnection);
 }
 
 DeviceClient::~DeviceClient() {
-    socket_->close();
+    io()->close();
+    stopShm();
+}
+
+void DeviceClient::useLocalSocket(const QString &name, quint32 ringBytes) {
+    if (!localSocket_) {
+        localSocket_ = new QLocalSocket(this);
+        connect(localSocket_, &QLocalSocket::connected, this, &DeviceClient::onConnected);
+        connect(localSocket_, &QLocalSocket::readyRead, this, &DeviceClient::onReadyRead);
+        connect(localSocket_, &QLocalSocket::disconnected, this, &DeviceClient::onDisconnected);
+        connect(localSocket_, &QLocalSocket::errorOccurred, this, [this](QLocalSocket::LocalSocketError) {
+            if (!isOnline() && !retryTimer_.isActive()) retryTimer_.start();
+        });
+    }
+    localName_ = name;
+    shmRingBytes_ = ringBytes;
+}
+
+QIODevice *DeviceClient::io() const {
+    if (localSocket_) return localSocket_;
+    return socket_;
+}
+
+void DeviceClient::enableUdp() {
+    if (!udp_) udp_ = new QUdpSocket(this);
+}
+
+bool DeviceClient::isOnline() const {
+    if (localSocket_) return localSocket_->state() == QLocalSocket::ConnectedState;
+    return socket_->state() == QAbstractSocket::ConnectedState;
+}
+
+void DeviceClient::writeFrame(const QByteArray &frame) {
+    if (shmState_ == ShmOff) {
+        io()->write(frame);
+        return;
+    }
+    shmPending_.append(frame);
+    if (shmState_ == ShmActive) flushShmPending();
+}
+
+void DeviceClient::flushShmPending() {
+    if (shmState_ != ShmActive || shmPending_.isEmpty()) return;
+    qint64 n = ring_.write(shmPending_.constData(), shmPending_.size());
+    if (n > 0) {
+        shmPending_.remove(0, n);
+        if (ring_.takeSleeper()) localSocket_->write("\x01", 1);
+    }
+    // ring is full, the server is behind; try again shortly
+    if (!shmPending_.isEmpty()) shmRetryTimer_.start();
+}
+
+void DeviceClient::startShm() {
+    const qint64 size = ShmRing::bytesNeeded(shmRingBytes_);
+    shm_.setKey(QStringLiteral("tt-shm-%1-%2")
+                    .arg(QCoreApplication::applicationPid())
+                    .arg(QRandomGenerator::global()->generate()));
+    if (!shm_.create(size, QSharedMemory::ReadWrite)) {
+        qWarning() << "Cannot create shared memory, staying on socket:" << shm_.errorString();
+        return;
+    }
+    ring_.init(shm_.data(), shmRingBytes_);
+    QJsonObject attach;
+    attach["type"] = "ShmAttach";
+    attach["key"] = shm_.key();
+    attach["size"] = size;
+    io()->write(packJson(attach));
+    // hold frames until the server confirms, then they go through the ring
+    shmState_ = ShmWaitingAck;
+}
+
+void DeviceClient::stopShm() {
+    shmState_ = ShmOff;
+    shmPending_.clear();
+    shmRetryTimer_.stop();
+    ring_.reset();
+    if (shm_.isAttached()) shm_.detach();
+}
+
+bool DeviceClient::enableSpool(const QString &path, qint64 capacityBytes, qint64 bytesPerSec) {
+    if (!spool_.open(path, capacityBytes)) {
+        qWarning() << "Cannot open spool" << path << ":" << spool_.errorString();
+        return false;
+    }
+    flushBatchBytes_ = qMax<qint64>(1, bytesPerSec * flushTimer_.interval() / 1000);
+    qInfo() << "Spooling to" << path << "capacity" << capacityBytes
+            << "bytes, pending" << spool_.bytesUsed();
+    if (spool_.discardedBytes() > 0)
+        qWarning() << "Spool had corrupt records," << spool_.discardedBytes() << "bytes discarded";
+    return true;
 }
 
 void DeviceClient::tryConnect() {
+    if (localSocket_) {
+        if (localSocket_->state() != QLocalSocket::UnconnectedState) return;
+        qInfo() << "Attempting to connect to local socket" << localName_;
+        localSocket_->connectToServer(localName_);
+        return;
+    }
     if (socket_->state() == QAbstractSocket::ConnectedState ||
         socket_->state() == QAbstractSocket::ConnectingState) return;
     qInfo() << "AAttempting to connect to" << host_ << port_;
@@ -50,7 +173,7 @@ void DeviceClient::onConnected() {
 }
 
 void DeviceClient::onReadyRead() {
-    buffer_.append(socket_->readAll());
+    buffer_.append(io()->readAll());
     QJsonDocument doc;
     while(tryExtractOne(buffer_, doc)) {
         if(doc.isObject()) {
@@ -63,17 +186,63 @@ void DeviceClient::onReadyRead() {
 }
 
 void DeviceClient::onDisconnected() {
+    flushTimer_.stop();
+    // an unconfirmed batch is still in the spool and goes again next time
+    flushInFlight_ = 0;
+    stopShm();
+    udpPort_ = 0;
+    if (!spool_.isOpen()) {
+        started_ = false;
+        sendTimer_.stop();
+    }
+    buffer_.clear();
+    if (redirecting_) {
+        redirecting_ = false;
+        QMetaObject::invokeMethod(this, &DeviceClient::tryConnect, Qt::QueuedConnection);
+        return;
+    }
+    // lost the shard (or the server), start over from the front node
+    host_ = frontHost_;
+    port_ = frontPort_;
     qInfo() << "Disconnected from server, will retry in 5s";
-    started_ = false;
-    sendTimer_.stop();
     retryTimer_.start();
 }
 
 void DeviceClient::handleServerJson(const QJsonObject &obj) {
     QString type = obj.value("type").toString();
-    if(type == "ConnectAck") {
+    if(type == "Redirect" && !localSocket_) {
+        host_ = obj.value("host").toString(frontHost_);
+        port_ = static_cast<quint16>(obj.value("port").toInt(frontPort_));
+        qInfo() << "Redirected to shard" << host_ << port_;
+        redirecting_ = true;
+        socket_->abort();
+        if (socket_->state() == QAbstractSocket::UnconnectedState && redirecting_) {
+            // abort() may not emit disconnected if the front already closed
+            onDisconnected();
+        }
+    }
+    else if(type == "ConnectAck") {
         clientId_ = obj.value("client_id").toString();
         qInfo() << "Got ConnectAck, client_id = " << clientId_;
+        if (localSocket_ && shmRingBytes_ > 0) startShm();
+        if (udp_ && !localSocket_) {
+            udpPort_ = static_cast<quint16>(obj.value("udp_port").toInt(0));
+            udpSeq_ = 0;
+            if (udpPort_) qInfo() << "Periodic telemetry over udp port" << udpPort_;
+        }
+        if (!spool_.isEmpty()) startFlush();
+    }
+    else if(type == "ShmAttachAck") {
+        if (obj.value("ok").toBool()) {
+            qInfo() << "Server attached to shared memory ring," << shmRingBytes_ << "bytes";
+            shmState_ = ShmActive;
+            flushShmPending();
+        } else {
+            qWarning() << "Server refused shared memory, staying on socket";
+            QByteArray pending = shmPending_;
+            stopShm();
+            io()->write(pending);
+        }
     }
     else if(type == "Command") {
         QString cmd = obj.value("command").toString().toUpper();
@@ -161,7 +330,8 @@ QJsonObject DeviceClient::produceRandomMessage() {
 }
 
 void DeviceClient::onSendTick() {
-    if (!started_ || socket_->state() != QTcpSocket::ConnectedState) {
+    const bool online = isOnline();
+    if (!started_ || (!online && !spool_.isOpen())) {
         sendTimer_.stop();
         return;
     }
@@ -179,12 +349,75 @@ void DeviceClient::onSendTick() {
             warning["type"] = "Log";
             warning["severity"] = "WARNING";
             warning["message"] = QStringLiteral("Threshold exceeded: latency=%1 pl=%2").arg(lat).arg(pl);
-            QByteArray wb = packJson(warning);
-            socket_->write(wb);
+            sendRecord(warning);
         }
     }
 
-    QByteArray out = packJson(msg);
-    socket_->write(out);
-    qInfo().noquote() << "Sent:" << msg.value("type").toString();
+    sendRecord(msg);
+    qInfo().noquote() << (online ? "Sent:" : "Spooled:") << msg.value("type").toString();
+}
+
+bool DeviceClient::sendDatagram(QJsonObject obj) {
+    const QString type = obj.value("type").toString();
+    if (type != "NetworkMetrics" && type != "DeviceStatus") return false;
+    obj["client_id"] = clientId_;
+    obj["seq"] = udpSeq_++;
+    const QByteArray data = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    // a full send buffer just loses this sample, the next one replaces it
+    udp_->writeDatagram(data, socket_->peerAddress(), udpPort_);
+    return true;
+}
+
+void DeviceClient::sendRecord(QJsonObject obj) {
+    if (isOnline()) {
+        if (udpPort_ && sendDatagram(obj)) return;
+        writeFrame(packJson(obj));
+        return;
+    }
+    if (!spool_.isOpen()) return;
+    // stamp at generation time so the server can place it correctly
+    obj["backfill"] = true;
+    obj["ts"] = QDateTime::currentMSecsSinceEpoch();
+    spool_.append(packJson(obj));
+}
+
+void DeviceClient::startFlush() {
+    QJsonObject begin;
+    begin["type"] = "Backfill";
+    begin["state"] = "begin";
+    begin["bytes"] = spool_.bytesUsed();
+    begin["dropped"] = static_cast<qint64>(spool_.dropped());
+    begin["discarded_bytes"] = static_cast<qint64>(spool_.discardedBytes());
+    writeFrame(packJson(begin));
+    qInfo() << "Flushing" << spool_.bytesUsed() << "spooled bytes";
+    flushInFlight_ = 0;
+    flushTimer_.start();
+}
+
+void DeviceClient::onFlushTick() {
+    if (!isOnline()) {
+        flushTimer_.stop();
+        return;
+    }
+    // wait until the previous batch (and live records behind it) has been
+    // handed to the OS or the shm ring; only then is it dropped from the
+    // spool, so a link that fails mid-batch resends it after reconnect
+    if (io()->bytesToWrite() > 0 || !shmPending_.isEmpty()) return;
+    if (flushInFlight_ > 0) {
+        spool_.consume(flushInFlight_);
+        flushInFlight_ = 0;
+    }
+
+    if (!spool_.isEmpty()) {
+        QByteArray batch = spool_.peek(flushBatchBytes_);
+        writeFrame(batch);
+        flushInFlight_ = batch.size();
+        return;
+    }
+    flushTimer_.stop();
+    QJsonObject end;
+    end["type"] = "Backfill";
+    end["state"] = "end";
+    writeFrame(packJson(end));
+    qInfo() << "Backfill done";
 }
@@ -1,8 +1,13 @@
 #pragma once
 #include <QObject>
 #include <QTcpSocket>
+#include <QLocalSocket>
+#include <QUdpSocket>
+#include <QSharedMemory>
 #include <QTimer>
 #include <QRandomGenerator>
+#include "OfflineSpool.h"
+#include "ShmRing.h"
 
 class DeviceClient : public QObject
 {
@@ -11,12 +16,25 @@ public:
     explicit DeviceClient(const QString &host = "127.0.0.1", quint16 port = 12345, QObject *parent = nullptr);
     ~DeviceClient() override;
 
+    // keep generating while disconnected and store records in a disk ring;
+    // after reconnect they are sent as backfill at bytesPerSec
+    bool enableSpool(const QString &path, qint64 capacityBytes, qint64 bytesPerSec);
+    // connect over a unix domain socket instead of tcp; with ringBytes > 0
+    // frames to the server then go through a shared-memory ring.
+    // call before the event loop starts
+    void useLocalSocket(const QString &name, quint32 ringBytes = 0);
+    // send NetworkMetrics/DeviceStatus as datagrams when the server offers a
+    // udp port in ConnectAck; everything else stays on the stream
+    void enableUdp();
+
 private slots:
     void tryConnect();
     void onConnected();
     void onReadyRead();
     void onDisconnected();
     void onSendTick();
+    void onFlushTick();
+    void flushShmPending();
 
 private:
     void handleServerJson(const QJsonObject &obj);
@@ -24,16 +42,49 @@ private:
     void stopSending();
     QString randomString(int length);
     QJsonObject produceRandomMessage();
+    void sendRecord(QJsonObject obj);
+    void startFlush();
+    QIODevice *io() const;
+    bool isOnline() const;
+    bool sendDatagram(QJsonObject obj);
+    void writeFrame(const QByteArray &frame);
+    void startShm();
+    void stopShm();
 
     QTcpSocket *socket_;
+    QLocalSocket *localSocket_;
+    QString localName_;
     QString host_;
     quint16 port_;
+    // address we were started with; a shard redirect is only kept until it drops
+    QString frontHost_;
+    quint16 frontPort_;
+    bool redirecting_;
     QTimer retryTimer_;
     QTimer sendTimer_;
     QByteArray buffer_;
     bool started_;
     QString clientId_;
 
+    OfflineSpool spool_;
+    QTimer flushTimer_;
+    qint64 flushBatchBytes_;
+    // last batch written but kept in the spool until it has left our buffers
+    qint64 flushInFlight_;
+
+    enum ShmState { ShmOff, ShmWaitingAck, ShmActive };
+    quint32 shmRingBytes_;
+    ShmState shmState_;
+    QSharedMemory shm_;
+    ShmRing ring_;
+    // frames waiting for the attach ack or for room in the ring
+    QByteArray shmPending_;
+    QTimer shmRetryTimer_;
+
+    QUdpSocket *udp_;
+    quint16 udpPort_;   // from ConnectAck, 0 while not offered
+    qint64 udpSeq_;
+
     int critLatencyMs_;
     double critPacketLoss_;
 };
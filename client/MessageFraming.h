@@ -4,12 +4,11 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
-inline QByteArray packJson(const QJsonObject &obj) {
-    QJsonDocument doc(obj);
-    QByteArray payload = doc.toJson(QJsonDocument::Compact);
+inline QByteArray packFrame(const QByteArray &payload) {
     QByteArray out;
     // Write 4-byte big-endian length
     quint32 len = static_cast<quint32>(payload.size());
+    out.reserve(4 + payload.size());
     out.resize(4);
     out[0] = static_cast<char>((len >> 24) & 0xFF);
     out[1] = static_cast<char>((len >> 16) & 0xFF);
@@ -19,25 +18,37 @@ inline QByteArray packJson(const QJsonObject &obj) {
     return out;
 }
 
-// try extract JSON from buffer; returns true on success and put in doc
+inline QByteArray packJson(const QJsonObject &obj) {
+    QJsonDocument doc(obj);
+    return packFrame(doc.toJson(QJsonDocument::Compact));
+}
+
+// try extract one raw payload (without prefix) from buffer; returns true on success
 // buffer is modified
-inline bool tryExtractOne(QByteArray &buffer, QJsonDocument &docOut) {
+inline bool tryExtractFrame(QByteArray &buffer, QByteArray &payloadOut) {
     if (buffer.size() < 4) return false;
     const unsigned char *data = reinterpret_cast<const unsigned char*>(buffer.constData());
     quint32 len = (static_cast<quint32>(data[0]) << 24) |
                   (static_cast<quint32>(data[1]) << 16) |
                   (static_cast<quint32>(data[2]) << 8) |
                   (static_cast<quint32>(data[3]));
-    if (buffer.size() < static_cast<int>(4 + len)) return false;
-    QByteArray payload = buffer.mid(4, len);
+    if (buffer.size() < static_cast<qint64>(4) + len) return false;
+    payloadOut = buffer.mid(4, len);
+    buffer.remove(0, 4 + len);
+    return true;
+}
+
+// try extract JSON from buffer; returns true on success and put in doc
+// buffer is modified
+inline bool tryExtractOne(QByteArray &buffer, QJsonDocument &docOut) {
+    QByteArray payload;
+    if (!tryExtractFrame(buffer, payload)) return false;
     QJsonParseError err;
     QJsonDocument doc = QJsonDocument::fromJson(payload, &err);
     if (err.error != QJsonParseError::NoError) {
-        // consume the bytes and return false (caller should handle)
-        buffer.remove(0, 4 + len);
+        // bytes are consumed, return false (caller should handle)
         return false;
     }
     docOut = doc;
-    buffer.remove(0, 4 + len);
     return true;
 }
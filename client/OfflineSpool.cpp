@@ -0,0 +1,165 @@
+#include "OfflineSpool.h"
+#include <cstring>
+
+static const quint32 kSpoolMagic = 0x53504F4C; // "SPOL"
+static const quint32 kSpoolVersion = 2;
+
+OfflineSpool::OfflineSpool()
+    : header_(nullptr),
+    ring_(nullptr)
+{
+}
+
+OfflineSpool::~OfflineSpool() {
+    close();
+}
+
+bool OfflineSpool::open(const QString &path, qint64 capacity) {
+    close();
+    if (capacity <= 0) return false;
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadWrite)) return false;
+
+    const qint64 total = static_cast<qint64>(sizeof(Header)) + capacity;
+    const bool reuse = file_.size() == total;
+    if (!reuse && !file_.resize(total)) {
+        file_.close();
+        return false;
+    }
+    uchar *base = file_.map(0, total);
+    if (!base) {
+        file_.close();
+        return false;
+    }
+    header_ = reinterpret_cast<Header*>(base);
+    ring_ = reinterpret_cast<char*>(base + sizeof(Header));
+
+    if (!reuse || header_->magic != kSpoolMagic || header_->version != kSpoolVersion ||
+        header_->capacity != static_cast<quint64>(capacity) ||
+        header_->head < header_->tail || header_->head - header_->tail > header_->capacity) {
+        header_->magic = kSpoolMagic;
+        header_->version = kSpoolVersion;
+        header_->capacity = static_cast<quint64>(capacity);
+        header_->head = 0;
+        header_->tail = 0;
+        header_->dropped = 0;
+        header_->discarded = 0;
+    }
+    // walk what a previous run left behind before trusting it
+    for (quint64 pos = header_->tail; pos != header_->head; ) {
+        const quint64 rec = recordSize(pos);
+        if (rec == 0) {
+            discardAll();
+            break;
+        }
+        pos += rec;
+    }
+    return true;
+}
+
+void OfflineSpool::close() {
+    if (header_) {
+        file_.unmap(reinterpret_cast<uchar*>(header_));
+        header_ = nullptr;
+        ring_ = nullptr;
+    }
+    if (file_.isOpen()) file_.close();
+}
+
+qint64 OfflineSpool::bytesUsed() const {
+    return header_ ? static_cast<qint64>(header_->head - header_->tail) : 0;
+}
+
+qint64 OfflineSpool::capacity() const {
+    return header_ ? static_cast<qint64>(header_->capacity) : 0;
+}
+
+quint64 OfflineSpool::dropped() const {
+    return header_ ? header_->dropped : 0;
+}
+
+quint64 OfflineSpool::discardedBytes() const {
+    return header_ ? header_->discarded : 0;
+}
+
+void OfflineSpool::discardAll() {
+    header_->discarded += header_->head - header_->tail;
+    header_->tail = header_->head;
+}
+
+void OfflineSpool::copyIn(quint64 pos, const char *src, qint64 n) {
+    const quint64 cap = header_->capacity;
+    const quint64 off = pos % cap;
+    const qint64 first = qMin<qint64>(n, static_cast<qint64>(cap - off));
+    std::memcpy(ring_ + off, src, first);
+    if (first < n) std::memcpy(ring_, src + first, n - first);
+}
+
+void OfflineSpool::copyOut(quint64 pos, char *dst, qint64 n) const {
+    const quint64 cap = header_->capacity;
+    const quint64 off = pos % cap;
+    const qint64 first = qMin<qint64>(n, static_cast<qint64>(cap - off));
+    std::memcpy(dst, ring_ + off, first);
+    if (first < n) std::memcpy(dst + first, ring_, n - first);
+}
+
+quint32 OfflineSpool::recordLength(quint64 pos) const {
+    unsigned char p[4];
+    copyOut(pos, reinterpret_cast<char*>(p), 4);
+    return (static_cast<quint32>(p[0]) << 24) | (static_cast<quint32>(p[1]) << 16) |
+           (static_cast<quint32>(p[2]) << 8) | static_cast<quint32>(p[3]);
+}
+
+quint64 OfflineSpool::recordSize(quint64 pos) const {
+    const quint64 avail = header_->head - pos;
+    if (pos > header_->head || avail < 4) return 0;
+    const quint64 rec = 4 + static_cast<quint64>(recordLength(pos));
+    return rec > avail ? 0 : rec;
+}
+
+bool OfflineSpool::append(const QByteArray &frame) {
+    if (!header_) return false;
+    const quint64 size = static_cast<quint64>(frame.size());
+    if (size < 4 || size > header_->capacity) return false;
+
+    // make room by dropping the oldest records
+    while (header_->head - header_->tail + size > header_->capacity) {
+        const quint64 rec = recordSize(header_->tail);
+        if (rec == 0) {
+            discardAll();
+            break;
+        }
+        header_->tail += rec;
+        ++header_->dropped;
+    }
+    copyIn(header_->head, frame.constData(), frame.size());
+    header_->head += size;
+    return true;
+}
+
+QByteArray OfflineSpool::peek(qint64 maxBytes) {
+    QByteArray out;
+    if (!header_) return out;
+    quint64 pos = header_->tail;
+    qint64 total = 0;
+    while (pos < header_->head) {
+        const qint64 rec = static_cast<qint64>(recordSize(pos));
+        if (rec == 0) {
+            // corrupt from here on; keep the good records before it
+            header_->discarded += header_->head - pos;
+            header_->head = pos;
+            break;
+        }
+        if (total > 0 && total + rec > maxBytes) break;
+        total += rec;
+        pos += rec;
+    }
+    out.resize(total);
+    copyOut(header_->tail, out.data(), total);
+    return out;
+}
+
+void OfflineSpool::consume(qint64 bytes) {
+    if (!header_ || bytes <= 0) return;
+    header_->tail += qMin<quint64>(static_cast<quint64>(bytes), header_->head - header_->tail);
+}
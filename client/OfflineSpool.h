@@ -0,0 +1,58 @@
+#pragma once
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+// bounded on-disk ring of framed messages, memory-mapped.
+// records are stored exactly as they go on the wire (4-byte length + JSON),
+// so a drained batch can be written to the socket as is.
+// when full, the oldest records are overwritten.
+// the file may be left torn by a crash, so record lengths are checked
+// against head before use; a bad chain discards the spooled content.
+class OfflineSpool
+{
+public:
+    OfflineSpool();
+    ~OfflineSpool();
+
+    // opens or creates the spool file; existing content is kept if it matches capacity
+    bool open(const QString &path, qint64 capacity);
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+    QString errorString() const { return file_.errorString(); }
+
+    bool append(const QByteArray &frame);
+    // whole records from the oldest, up to maxBytes (at least one record)
+    QByteArray peek(qint64 maxBytes);
+    void consume(qint64 bytes);
+
+    bool isEmpty() const { return bytesUsed() == 0; }
+    qint64 bytesUsed() const;
+    qint64 capacity() const;
+    quint64 dropped() const;
+    // bytes thrown away because the stored records were corrupt
+    quint64 discardedBytes() const;
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint64 capacity;
+        quint64 head; // write position, monotonic
+        quint64 tail; // read position, monotonic
+        quint64 dropped;
+        quint64 discarded;
+    };
+
+    void copyIn(quint64 pos, const char *src, qint64 n);
+    void copyOut(quint64 pos, char *dst, qint64 n) const;
+    quint32 recordLength(quint64 pos) const;
+    // size of the record at pos including its prefix, 0 if it is not a
+    // valid record inside [pos, head)
+    quint64 recordSize(quint64 pos) const;
+    void discardAll();
+
+    QFile file_;
+    Header *header_;
+    char *ring_;
+};
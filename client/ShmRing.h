@@ -0,0 +1,133 @@
+// single-producer single-consumer byte ring living in shared memory.
+// it is a byte stream carrying the same length-prefixed frames as the
+// sockets, so a frame may be split across writes; the consumer re-frames.
+// the other process can still write the header at any time, so each side
+// keeps capacity and its own cursor locally and checks what it reads.
+#pragma once
+#include <QByteArray>
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+class ShmRing
+{
+public:
+    struct Header {
+        quint32 magic;
+        quint32 capacity;
+        alignas(64) std::atomic<quint64> head;   // bytes written, producer owned
+        alignas(64) std::atomic<quint64> tail;   // bytes read, consumer owned
+        // consumer found the ring empty and waits for a doorbell
+        alignas(64) std::atomic<quint32> consumerSleeping;
+    };
+
+    static const quint32 kMagic = 0x52494E47; // "RING"
+
+    static qint64 bytesNeeded(quint32 capacity) {
+        return static_cast<qint64>(sizeof(Header)) + capacity;
+    }
+
+    ShmRing() : hdr_(nullptr), data_(nullptr), capacity_(0), tail_(0) {}
+
+    // producer side, formats fresh memory
+    void init(void *mem, quint32 capacity) {
+        hdr_ = new (mem) Header;
+        hdr_->capacity = capacity;
+        capacity_ = capacity;
+        tail_ = 0;
+        hdr_->head.store(0, std::memory_order_relaxed);
+        hdr_->tail.store(0, std::memory_order_relaxed);
+        hdr_->consumerSleeping.store(0, std::memory_order_relaxed);
+        data_ = static_cast<char*>(mem) + sizeof(Header);
+        std::atomic_thread_fence(std::memory_order_release);
+        hdr_->magic = kMagic;
+    }
+
+    // consumer side, checks memory formatted by init(); size is the real
+    // size of the mapping, capacity is taken from the header once here
+    bool attach(void *mem, qint64 size) {
+        if (size < static_cast<qint64>(sizeof(Header))) return false;
+        Header *h = static_cast<Header*>(mem);
+        const quint32 capacity = h->capacity;
+        if (h->magic != kMagic || capacity == 0 || bytesNeeded(capacity) > size) return false;
+        hdr_ = h;
+        data_ = static_cast<char*>(mem) + sizeof(Header);
+        capacity_ = capacity;
+        tail_ = h->tail.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    bool isValid() const { return hdr_ != nullptr; }
+    void reset() { hdr_ = nullptr; data_ = nullptr; capacity_ = 0; tail_ = 0; }
+    quint32 capacity() const { return capacity_; }
+
+    // producer: writes as much as fits, returns the byte count
+    qint64 write(const char *src, qint64 n) {
+        const quint64 head = hdr_->head.load(std::memory_order_relaxed);
+        const quint64 tail = hdr_->tail.load(std::memory_order_acquire);
+        if (tail > head || head - tail > capacity_) return 0;
+        const qint64 room = static_cast<qint64>(capacity_) - static_cast<qint64>(head - tail);
+        n = qMin(n, room);
+        if (n <= 0) return 0;
+        copyIn(head, src, n);
+        hdr_->head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer: everything currently available, up to maxBytes.
+    // false if the producer published an impossible head (protocol error)
+    bool read(qint64 maxBytes, QByteArray &out) {
+        out.clear();
+        const quint64 head = hdr_->head.load(std::memory_order_acquire);
+        if (head < tail_ || head - tail_ > capacity_) return false;
+        const qint64 n = qMin<qint64>(static_cast<qint64>(head - tail_), maxBytes);
+        if (n <= 0) return true;
+        out.resize(n);
+        copyOut(tail_, out.data(), n);
+        tail_ += n;
+        hdr_->tail.store(tail_, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return hdr_->head.load(std::memory_order_acquire) == tail_;
+    }
+
+    // consumer announces it is about to wait; returns false if data raced in
+    bool prepareSleep() {
+        hdr_->consumerSleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!isEmpty()) {
+            hdr_->consumerSleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // producer: true if the consumer was waiting and needs a doorbell
+    bool takeSleeper() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return hdr_->consumerSleeping.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+private:
+    void copyIn(quint64 pos, const char *src, qint64 n) {
+        const quint32 off = static_cast<quint32>(pos % capacity_);
+        const qint64 first = qMin<qint64>(n, capacity_ - off);
+        std::memcpy(data_ + off, src, first);
+        if (first < n) std::memcpy(data_, src + first, n - first);
+    }
+
+    void copyOut(quint64 pos, char *dst, qint64 n) const {
+        const quint32 off = static_cast<quint32>(pos % capacity_);
+        const qint64 first = qMin<qint64>(n, capacity_ - off);
+        std::memcpy(dst, data_ + off, first);
+        if (first < n) std::memcpy(dst + first, data_, n - first);
+    }
+
+    Header *hdr_;
+    char *data_;
+    quint32 capacity_;
+    quint64 tail_;   // consumer cursor, never read back from shared memory
+};
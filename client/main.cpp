@@ -1,8 +1,41 @@
 #include <QCoreApplication>
+#include <QCommandLineParser>
 #include "DeviceClient.h"
 
 int main(int argc, char **argv) {
     QCoreApplication a(argc, argv);
-    DeviceClient client("127.0.0.1", 12345, &a);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption hostOpt("host", "Server (or front node) address.", "host", "127.0.0.1");
+    QCommandLineOption portOpt("port", "Server (or front node) port.", "port", "12345");
+    QCommandLineOption localOpt("local", "Connect over a unix domain socket with this name instead of tcp.", "name");
+    QCommandLineOption shmOpt("shm", "With --local, send frames through a shared-memory ring of this many KB.", "kb");
+    QCommandLineOption udpOpt("udp", "Send periodic metrics over udp if the server offers it.");
+    QCommandLineOption spoolOpt("spool", "Spool file for telemetry generated while disconnected.", "path");
+    QCommandLineOption spoolSizeOpt("spool-size", "Spool capacity, MB.", "mb", "64");
+    QCommandLineOption spoolRateOpt("spool-rate", "Backfill rate after reconnect, KB/s.", "kbps", "1024");
+    parser.addOption(hostOpt);
+    parser.addOption(portOpt);
+    parser.addOption(localOpt);
+    parser.addOption(shmOpt);
+    parser.addOption(udpOpt);
+    parser.addOption(spoolOpt);
+    parser.addOption(spoolSizeOpt);
+    parser.addOption(spoolRateOpt);
+    parser.process(a);
+
+    DeviceClient client(parser.value(hostOpt), parser.value(portOpt).toUShort(), &a);
+    if (parser.isSet(localOpt)) {
+        client.useLocalSocket(parser.value(localOpt), parser.value(shmOpt).toUInt() * 1024);
+    }
+    if (parser.isSet(udpOpt)) {
+        client.enableUdp();
+    }
+    if (parser.isSet(spoolOpt)) {
+        client.enableSpool(parser.value(spoolOpt),
+                           parser.value(spoolSizeOpt).toLongLong() * 1024 * 1024,
+                           parser.value(spoolRateOpt).toLongLong() * 1024);
+    }
     return a.exec();
 }
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# Local scale-out run: N headless shards, one GUI front node, M clients.
+# usage: scripts/run_sharded.sh <shards> <clients> [server_bin] [client_bin]
+set -euo pipefail
+
+SHARDS=${1:-2}
+CLIENTS=${2:-10}
+SERVER=${3:-server/build/server}
+CLIENT=${4:-client/build/client}
+FRONT_PORT=12345
+BASE_PORT=12400
+
+pids=()
+trap 'kill "${pids[@]}" 2>/dev/null || true' EXIT
+
+list=""
+for ((i = 0; i < SHARDS; i++)); do
+    port=$((BASE_PORT + i))
+    "$SERVER" --headless --port "$port" --front 127.0.0.1 > "shard_$port.log" 2>&1 &
+    pids+=($!)
+    list+="${list:+,}127.0.0.1:$port"
+done
+
+"$SERVER" --port "$FRONT_PORT" --shards "$list" &
+pids+=($!)
+sleep 1
+
+for ((i = 0; i < CLIENTS; i++)); do
+    "$CLIENT" --host 127.0.0.1 --port "$FRONT_PORT" > /dev/null 2>&1 &
+    pids+=($!)
+done
+
+wait "${pids[$SHARDS]}"
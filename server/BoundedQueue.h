@@ -0,0 +1,73 @@
+// blocking FIFO with a fixed capacity, used between pipeline stages.
+#pragma once
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity) : capacity_(capacity), closed_(false) {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // blocks while full; returns false once the queue is closed
+    bool push(T item) {
+        QMutexLocker locker(&mutex_);
+        while (queue_.size() >= capacity_ && !closed_) notFull_.wait(&mutex_);
+        if (closed_) return false;
+        queue_.enqueue(std::move(item));
+        notEmpty_.wakeOne();
+        return true;
+    }
+
+    // never blocks; false when full or closed, the item is then dropped
+    bool tryPush(T item) {
+        QMutexLocker locker(&mutex_);
+        if (closed_ || queue_.size() >= capacity_) return false;
+        queue_.enqueue(std::move(item));
+        notEmpty_.wakeOne();
+        return true;
+    }
+
+    // blocks while empty; after close() remaining items are still handed out
+    bool pop(T &out) {
+        QMutexLocker locker(&mutex_);
+        while (queue_.isEmpty() && !closed_) notEmpty_.wait(&mutex_);
+        if (queue_.isEmpty()) return false;
+        out = queue_.dequeue();
+        notFull_.wakeOne();
+        return true;
+    }
+
+    void close() {
+        QMutexLocker locker(&mutex_);
+        closed_ = true;
+        notEmpty_.wakeAll();
+        notFull_.wakeAll();
+    }
+
+    // reopen an empty, closed queue for reuse
+    void reset() {
+        QMutexLocker locker(&mutex_);
+        queue_.clear();
+        closed_ = false;
+    }
+
+    int size() const {
+        QMutexLocker locker(&mutex_);
+        return queue_.size();
+    }
+
+    int capacity() const { return capacity_; }
+
+private:
+    mutable QMutex mutex_;
+    QWaitCondition notEmpty_;
+    QWaitCondition notFull_;
+    QQueue<T> queue_;
+    const int capacity_;
+    bool closed_;
+};
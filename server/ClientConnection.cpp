@@ -4,39 +4,69 @@
 #include <QUuid>
 #include <QDataStream>
 
+// one drain pass hands at most this much to the pipeline before yielding
+static const qint64 kRingDrainBytes = 4 * 1024 * 1024;
+// unread socket data Qt may hold for a paused client before it stops reading
+static const qint64 kReadBufferBytes = 1024 * 1024;
+
 ClientConnection::ClientConnection(QTcpSocket *socket, QObject *parent)
     : QObject(parent),
-    socket_(socket)
+    socket_(socket),
+    tcp_(socket),
+    local_(nullptr),
+    paused_(false),
+    closing_(false)
 {
+    connect(tcp_, &QTcpSocket::disconnected, this, &ClientConnection::onDisconnected);
+    tcp_->setReadBufferSize(kReadBufferBytes);
+    init();
+}
+
+ClientConnection::ClientConnection(QLocalSocket *socket, QObject *parent)
+    : QObject(parent),
+    socket_(socket),
+    tcp_(nullptr),
+    local_(socket),
+    paused_(false),
+    closing_(false)
+{
+    connect(local_, &QLocalSocket::disconnected, this, &ClientConnection::onDisconnected);
+    local_->setReadBufferSize(kReadBufferBytes);
+    init();
+}
+
+void ClientConnection::init() {
     socket_->setParent(this);
     client_id_ = QUuid::createUuid().toString(QUuid::WithoutBraces);
 
-    connect(socket_, &QTcpSocket::readyRead, this, &ClientConnection::onReadyRead);
-    connect(socket_, &QTcpSocket::disconnected, this, &ClientConnection::onDisconnected);
+    connect(socket_, &QIODevice::readyRead, this, &ClientConnection::onReadyRead);
     emit logMessage(QStringLiteral("ClientConnection created: %1 (%2:%3)")
         .arg(client_id_)
-        .arg(socket_->peerAddress().toString())
-        .arg(socket_->peerPort()));
-
-    QJsonObject ack;
-    ack["type"] = QStringLiteral("ConnectAck");
-    ack["client_id"] = client_id_;
-    sendJson(ack);
+        .arg(peerName())
+        .arg(peerPort()));
 }
 
 ClientConnection::~ClientConnection(){
     if(socket_){
         socket_->close();
     }
+    ring_.reset();
+    if(shm_.isAttached()) shm_.detach();
 }
 
 QHostAddress ClientConnection::peerAddress() const {
-    if(socket_) return socket_->peerAddress();
+    if(tcp_) return tcp_->peerAddress();
     return QHostAddress();
 }
 
 quint16 ClientConnection::peerPort() const {
-    if(socket_) return socket_->peerPort();
+    if(tcp_) return tcp_->peerPort();
+    return 0;
+}
+
+QString ClientConnection::peerName() const {
+    if(tcp_) return tcp_->peerAddress().toString();
+    return ring_.isValid() ? QStringLiteral("shm") : QStringLiteral("unix");
 }
 
 void ClientConnection::sendJson(const QJsonObject &obj) {
@@ -45,20 +75,103 @@ void ClientConnection::sendJson(const QJsonObject &obj) {
     socket_->write(out);
 }
 
+void ClientConnection::sendPayload(const QByteArray &payload) {
+    if(!socket_) return;
+    socket_->write(packFrame(payload));
+}
+
 void ClientConnection::onReadyRead() {
+    // bytes stay in the socket until resume()
+    if(paused_) return;
+    if(ring_.isValid()) {
+        // after the switch the socket only carries doorbell bytes
+        socket_->readAll();
+        drainRing();
+        return;
+    }
     buffer_.append(socket_->readAll());
-    QJsonDocument doc;
-    while (tryExtractOne(buffer_, doc)) {
-        if(!doc.isNull() && doc.isObject()) {
-            emit jsonReceived(client_id_, doc.object());
+    emitFrames();
+}
+
+void ClientConnection::resume() {
+    if(!paused_) return;
+    paused_ = false;
+    emitFrames();
+    // pick up what arrived in the meantime
+    if(!paused_ && socket_->bytesAvailable() > 0) onReadyRead();
+    else drainRing();
+    if(!paused_ && closing_) onDisconnected();
+}
+
+bool ClientConnection::handleShmAttach(const QByteArray &payload) {
+    QJsonObject obj = QJsonDocument::fromJson(payload).object();
+    if(obj.value("type").toString() != "ShmAttach") return false;
+
+    QJsonObject reply;
+    reply["type"] = QStringLiteral("ShmAttachAck");
+    shm_.setKey(obj.value("key").toString());
+    if(!shm_.attach(QSharedMemory::ReadWrite) || !ring_.attach(shm_.data(), shm_.size())) {
+        emit logMessage(QStringLiteral("Shared memory attach failed for %1: %2").arg(client_id_, shm_.errorString()));
+        if(shm_.isAttached()) shm_.detach();
+        reply["ok"] = false;
+        sendJson(reply);
+        return true;
+    }
+    reply["ok"] = true;
+    sendJson(reply);
+    // from here on socket bytes are doorbells, not frames
+    buffer_.clear();
+    emit logMessage(QStringLiteral("Client %1 switched to shared memory (%2 bytes)").arg(client_id_).arg(ring_.capacity()));
+    drainRing();
+    return true;
+}
+
+void ClientConnection::drainRing() {
+    if(!ring_.isValid() || paused_) return;
+    qint64 budget = kRingDrainBytes;
+    QByteArray chunk;
+    for(;;) {
+        if(!ring_.read(budget, chunk)) {
+            // the client corrupted the ring header, it cannot be trusted further
+            emit logMessage(QStringLiteral("Client %1: invalid shared memory ring state, dropping").arg(client_id_));
+            ring_.reset();
+            shm_.detach();
+            local_->abort();
+            return;
+        }
+        if(!chunk.isEmpty()) {
+            budget -= chunk.size();
+            buffer_.append(chunk);
+            emitFrames();
+            if(paused_) return;
+        }
+        if(budget <= 0) {
+            // let the event loop breathe, come back right after
+            QMetaObject::invokeMethod(this, &ClientConnection::drainRing, Qt::QueuedConnection);
+            return;
         }
-        else {
-            emit logMessage(QStringLiteral("Received invalid JSON from %1").arg(client_id_));
+        if(ring_.prepareSleep()) return;
+    }
+}
+
+void ClientConnection::emitFrames() {
+    QByteArray payload;
+    while (!paused_ && tryExtractFrame(buffer_, payload)) {
+        if(local_ && !ring_.isValid() && payload.contains("\"ShmAttach\"") && handleShmAttach(payload)) {
+            // client holds its frames until the ack, nothing else is buffered
+            continue;
         }
+        emit frameReceived(client_id_, payload);
+        // paused by the receiver, the frame goes out again on resume()
+        if(paused_) buffer_.prepend(packFrame(payload));
     }
 }
 
 void ClientConnection::onDisconnected() {
+    closing_ = true;
+    // pick up whatever the client managed to publish before closing
+    drainRing();
+    if(paused_) return;
     emit logMessage(QStringLiteral("Client disconnected: %1").arg(client_id_));
     emit disconnected(client_id_);
     socket_->deleteLater();
@@ -1,33 +1,67 @@
 #pragma once
 #include <QObject>
 #include <QTcpSocket>
+#include <QLocalSocket>
+#include <QSharedMemory>
 #include <QByteArray>
 #include <QJsonObject>
+#include "ShmRing.h"
 
 class ClientConnection : public QObject {
     Q_OBJECT
 public:
     explicit ClientConnection(QTcpSocket *socket, QObject *parent = nullptr);
+    // co-located client over a unix domain socket; may switch its
+    // upstream frames to a shared-memory ring (see ShmAttach)
+    explicit ClientConnection(QLocalSocket *socket, QObject *parent = nullptr);
     ~ClientConnection() override;
 
     QString id() const { return client_id_; }
     QHostAddress peerAddress() const;
     quint16 peerPort() const;
+    // "ip" for tcp, "unix" or "shm" for local clients
+    QString peerName() const;
+    bool isLocal() const { return local_ != nullptr; }
+
+    // stop handing out frames; when called from a frameReceived() handler that
+    // frame is kept too. the socket and the ring are no longer read, so the
+    // client is held back by tcp flow control or a full ring
+    void pause() { paused_ = true; }
+    // hand out what was held back and read on
+    void resume();
+    bool isPaused() const { return paused_; }
 
 public slots:
     void sendJson(const QJsonObject &obj);
+    // already encoded frame body
+    void sendPayload(const QByteArray &payload);
 
 signals:
-    void jsonReceived(const QString &clientId, const QJsonObject &obj);
+    // raw frame body; decoding happens in the server pipeline
+    void frameReceived(const QString &clientId, const QByteArray &payload);
     void disconnected(const QString &clientId);
     void logMessage(const QString &msg);
 
 private slots:
     void onReadyRead();
     void onDisconnected();
+    void drainRing();
 
 private:
-    QTcpSocket *socket_;
+    void init();
+    bool handleShmAttach(const QByteArray &payload);
+    void emitFrames();
+
+    QIODevice *socket_;
+    QTcpSocket *tcp_;
+    QLocalSocket *local_;
     QByteArray buffer_;
     QString client_id_;
+
+    QSharedMemory shm_;
+    ShmRing ring_;
+
+    bool paused_;
+    // peer is gone, close once the held back frames are out
+    bool closing_;
 };
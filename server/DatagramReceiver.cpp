@@ -0,0 +1,222 @@
+#include "DatagramReceiver.h"
+#include "MessagePipeline.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#else
+#include <QUdpSocket>
+#include <QNetworkDatagram>
+#endif
+
+static const int kBatch = 64;
+static const int kMaxDatagram = 2048;
+// batches per wakeup before going back to the event loop
+static const int kMaxRounds = 16;
+// recent seq numbers remembered per client to tell late from duplicate
+static const qint64 kSeqWindow = 64;
+
+DatagramReceiver::DatagramReceiver(MessagePipeline *pipeline, QObject *parent)
+    : QObject(parent),
+    pipeline_(pipeline),
+#ifdef Q_OS_LINUX
+    fd_(-1),
+    notifier_(nullptr),
+#else
+    socket_(nullptr),
+#endif
+    port_(0),
+    statsTimer_(this),
+    rejected_(0),
+    reportedRejected_(0),
+    overflow_(0),
+    reportedOverflow_(0)
+{
+    connect(&statsTimer_, &QTimer::timeout, this, &DatagramReceiver::onStatsTick);
+    statsTimer_.setInterval(2000);
+}
+
+DatagramReceiver::~DatagramReceiver() {
+    close();
+}
+
+bool DatagramReceiver::bind(quint16 port) {
+    close();
+#ifdef Q_OS_LINUX
+    // dual-stack socket, v4 peers show up as v4-mapped addresses
+    fd_ = ::socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        error_ = QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+    int off = 0;
+    ::setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    int rcvbuf = 4 * 1024 * 1024;
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    sockaddr_in6 addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        error_ = QString::fromLocal8Bit(std::strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    recvBuf_.resize(kBatch * kMaxDatagram);
+    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &DatagramReceiver::onReadable);
+#else
+    socket_ = new QUdpSocket(this);
+    if (!socket_->bind(QHostAddress::Any, port)) {
+        error_ = socket_->errorString();
+        delete socket_;
+        socket_ = nullptr;
+        return false;
+    }
+    connect(socket_, &QUdpSocket::readyRead, this, &DatagramReceiver::onReadable);
+#endif
+    port_ = port;
+    statsTimer_.start();
+    return true;
+}
+
+void DatagramReceiver::close() {
+    statsTimer_.stop();
+#ifdef Q_OS_LINUX
+    delete notifier_;
+    notifier_ = nullptr;
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+#else
+    delete socket_;
+    socket_ = nullptr;
+#endif
+    port_ = 0;
+    peers_.clear();
+}
+
+void DatagramReceiver::allowClient(const QString &clientId, const QHostAddress &addr) {
+    Peer p;
+    p.addr = addr;
+    peers_.insert(clientId, p);
+}
+
+void DatagramReceiver::removeClient(const QString &clientId) {
+    peers_.remove(clientId);
+}
+
+void DatagramReceiver::onReadable() {
+#ifdef Q_OS_LINUX
+    mmsghdr msgs[kBatch];
+    iovec iov[kBatch];
+    sockaddr_storage from[kBatch];
+    char *buf = recvBuf_.data();
+    for (int round = 0; round < kMaxRounds; ++round) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < kBatch; ++i) {
+            iov[i].iov_base = buf + i * kMaxDatagram;
+            iov[i].iov_len = kMaxDatagram;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+        int n = ::recvmmsg(fd_, msgs, kBatch, MSG_DONTWAIT, nullptr);
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                ++rejected_;
+                continue;
+            }
+            handleDatagram(buf + i * kMaxDatagram, msgs[i].msg_len,
+                           QHostAddress(reinterpret_cast<sockaddr*>(&from[i])));
+        }
+        if (n < kBatch) break;
+    }
+#else
+    for (int i = 0; i < kBatch * kMaxRounds && socket_->hasPendingDatagrams(); ++i) {
+        QNetworkDatagram d = socket_->receiveDatagram(kMaxDatagram);
+        const QByteArray data = d.data();
+        handleDatagram(data.constData(), data.size(), d.senderAddress());
+    }
+#endif
+}
+
+void DatagramReceiver::handleDatagram(const char *data, qint64 size, const QHostAddress &from) {
+    QByteArray payload(data, static_cast<int>(size));
+    QJsonObject obj = QJsonDocument::fromJson(payload).object();
+    const QString clientId = obj.value("client_id").toString();
+    auto it = peers_.find(clientId);
+    if (it == peers_.end() || !it->addr.isEqual(from, QHostAddress::TolerantConversion)) {
+        // unknown id or not sent from where that client is connected
+        ++rejected_;
+        return;
+    }
+    const QString type = obj.value("type").toString();
+    if (type != "NetworkMetrics" && type != "DeviceStatus") {
+        ++rejected_;
+        return;
+    }
+
+    if (!obj.value("seq").isDouble() || obj.value("seq").toDouble() < 0) {
+        ++rejected_;
+        return;
+    }
+
+    Peer &p = it.value();
+    const qint64 seq = obj.value("seq").toVariant().toLongLong();
+    p.dirty = true;
+    if (seq <= p.highestSeq) {
+        const qint64 age = p.highestSeq - seq;
+        if (age >= kSeqWindow) {
+            // too old to tell whether it was missing or is a duplicate
+            ++p.late;
+            return;
+        }
+        const quint64 bit = quint64(1) << age;
+        if (p.seen & bit) return; // duplicate
+        // a newer sample already went through, so it is not delivered, but
+        // it was not lost either
+        p.seen |= bit;
+        ++p.late;
+        if (p.lost > 0) --p.lost;
+        return;
+    }
+    if (p.highestSeq >= 0) {
+        const qint64 gap = seq - p.highestSeq;
+        p.lost += static_cast<quint64>(gap - 1);
+        p.seen = gap >= kSeqWindow ? 0 : p.seen << gap;
+    }
+    p.seen |= 1;
+    // never wait for the pipeline here, a full queue must not stall tcp traffic
+    if (!pipeline_->trySubmit(clientId, payload, obj)) {
+        ++p.lost;
+        ++overflow_;
+        return;
+    }
+    ++p.received;
+}
+
+void DatagramReceiver::onStatsTick() {
+    if (rejected_ != reportedRejected_) {
+        emit logMessage(QStringLiteral("UDP: %1 datagram(s) rejected").arg(rejected_ - reportedRejected_));
+        reportedRejected_ = rejected_;
+    }
+    if (overflow_ != reportedOverflow_) {
+        emit logMessage(QStringLiteral("UDP: %1 sample(s) dropped, pipeline full").arg(overflow_ - reportedOverflow_));
+        reportedOverflow_ = overflow_;
+    }
+    for (auto it = peers_.begin(); it != peers_.end(); ++it) {
+        if (!it->dirty) continue;
+        it->dirty = false;
+        emit lossUpdated(it.key(), it->received, it->lost, it->late);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <QObject>
+#include <QHostAddress>
+#include <QHash>
+#include <QTimer>
+#include <QByteArray>
+
+#ifdef Q_OS_LINUX
+class QSocketNotifier;
+#else
+class QUdpSocket;
+#endif
+class MessagePipeline;
+
+// loss-tolerant path for periodic samples (NetworkMetrics, DeviceStatus).
+// each datagram is one JSON object carrying the client_id from ConnectAck
+// and a per-client seq. it is accepted only from the address of that
+// client's tcp connection; samples older than the newest one are dropped
+// since the next sample replaces them anyway, and counted as late unless
+// they are duplicates.
+// on linux datagrams are pulled in batches with recvmmsg().
+class DatagramReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DatagramReceiver(MessagePipeline *pipeline, QObject *parent = nullptr);
+    ~DatagramReceiver() override;
+
+    bool bind(quint16 port);
+    void close();
+    quint16 port() const { return port_; }
+    QString errorString() const { return error_; }
+
+    void allowClient(const QString &clientId, const QHostAddress &addr);
+    void removeClient(const QString &clientId);
+
+signals:
+    // totals since the client connected, sent when they change: delivered,
+    // never arrived (or dropped on overload), arrived after a newer sample
+    void lossUpdated(const QString &clientId, quint64 received, quint64 lost, quint64 late);
+    void logMessage(const QString &msg);
+
+private slots:
+    void onReadable();
+    void onStatsTick();
+
+private:
+    struct Peer {
+        QHostAddress addr;
+        qint64 highestSeq = -1;
+        quint64 received = 0;
+        quint64 lost = 0;
+        quint64 late = 0;
+        // bit i set: highestSeq - i has been seen
+        quint64 seen = 0;
+        bool dirty = false;
+    };
+
+    void handleDatagram(const char *data, qint64 size, const QHostAddress &from);
+
+    MessagePipeline *pipeline_;
+    QHash<QString, Peer> peers_;
+#ifdef Q_OS_LINUX
+    int fd_;
+    QSocketNotifier *notifier_;
+    QByteArray recvBuf_;
+#else
+    QUdpSocket *socket_;
+#endif
+    quint16 port_;
+    QString error_;
+    QTimer statsTimer_;
+    quint64 rejected_;
+    quint64 reportedRejected_;
+    // accepted but dropped because the pipeline was full, counted as loss
+    quint64 overflow_;
+    quint64 reportedOverflow_;
+};
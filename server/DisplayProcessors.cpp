@@ -0,0 +1,55 @@
+#include "DisplayProcessors.h"
+#include <QJsonDocument>
+#include <QDateTime>
+
+static void formatNetworkMetrics(PipelineMessage &msg) {
+    const double bw = msg.obj.value("bandwidth").toDouble();
+    const double lat = msg.obj.value("latency").toDouble();
+    const double pl = msg.obj.value("packet_loss").toDouble();
+    msg.results["content"] = QString("bw=%1 latency=%2 pl=%3").arg(bw).arg(lat).arg(pl);
+    QVariantMap samples;
+    samples["bandwidth"] = bw;
+    samples["latency"] = lat;
+    samples["packet_loss"] = pl;
+    msg.results["samples"] = samples;
+}
+
+static void formatDeviceStatus(PipelineMessage &msg) {
+    const qint64 uptime = msg.obj.value("uptime").toInt();
+    const int cpu = msg.obj.value("cpu_usage").toInt();
+    const int mem = msg.obj.value("memory_usage").toInt();
+    msg.results["content"] = QString("uptime=%1 cpu=%2 mem=%3").arg(uptime).arg(cpu).arg(mem);
+    QVariantMap samples;
+    samples["cpu_usage"] = cpu;
+    samples["memory_usage"] = mem;
+    msg.results["samples"] = samples;
+}
+
+static void formatLog(PipelineMessage &msg) {
+    const QString text = msg.obj.value("message").toString();
+    msg.results["content"] = QString("[%1] %2").arg(msg.obj.value("severity").toString(), text);
+    msg.results["text"] = text;
+}
+
+// runs after the type-specific ones
+static void finishDisplay(PipelineMessage &msg) {
+    QString content = msg.results.value("content").toString();
+    if (!msg.results.contains("content"))
+        content = QString::fromUtf8(QJsonDocument(msg.obj).toJson(QJsonDocument::Compact));
+    if (msg.obj.value("backfill").toBool()) content += " (backfill)";
+    msg.results["content"] = content;
+    // backfilled records carry their generation time
+    msg.results["time"] = msg.obj.contains("ts") ? msg.obj.value("ts").toVariant().toLongLong()
+                                                 : QDateTime::currentMSecsSinceEpoch();
+}
+
+void registerDisplayProcessors(ProcessorRegistry &registry) {
+    registry.registerProcessor("NetworkMetrics",
+        std::make_shared<FunctionProcessor>("format NetworkMetrics", formatNetworkMetrics));
+    registry.registerProcessor("DeviceStatus",
+        std::make_shared<FunctionProcessor>("format DeviceStatus", formatDeviceStatus));
+    registry.registerProcessor("Log",
+        std::make_shared<FunctionProcessor>("format Log", formatLog));
+    registry.registerProcessor(ProcessorRegistry::anyType(),
+        std::make_shared<FunctionProcessor>("display", finishDisplay));
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "MessageProcessor.h"
+
+// pipeline processors that prepare device telemetry for the GUI, so the
+// GUI thread only appends what it gets. results they fill in:
+//   "content"  QString      text for the data table
+//   "text"     QString      searchable words, the raw Log message
+//   "time"     qint64       ms since epoch, generation time for backfill
+//   "samples"  QVariantMap  metric name -> value for the charts
+void registerDisplayProcessors(ProcessorRegistry &registry);
@@ -1,6 +1,16 @@
 #include "MainWindow.h"
 #include "ServerManager.h"
+#include "MessageTableModel.h"
+#include "MessagePipeline.h"
+#include "DisplayProcessors.h"
+#include "TimeSeriesBuffer.h"
+#include "TimeSeriesChart.h"
 #include <QTableWidget>
+#include <QTableView>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QElapsedTimer>
 #include <QPushButton>
 #include <QTextEdit>
 #include <QLabel>
@@ -8,15 +18,18 @@
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QJsonObject>
-#include <QJsonDocument>
 #include <QMessageBox>
 #include <QInputDialog>
+#include <QDateTime>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
     serverManager_(nullptr),
     serverThread_(nullptr),
-    listenPort_(12345)
+    listenPort_(12345),
+    publishPort_(12346),
+    datagramPort_(12347),
+    localName_("tt-server")
 {
     setupUi();
 }
@@ -28,6 +41,8 @@ MainWindow::~MainWindow() {
         serverThread_->wait();
         delete serverThread_;
     }
+    chart_->setSeries(nullptr, QString());
+    qDeleteAll(series_);
 }
 
 void MainWindow::setupUi() {
@@ -50,17 +65,68 @@ void MainWindow::setupUi() {
 
     // clients table
     clientsTable_ = new QTableWidget;
-    clientsTable_->setColumnCount(4);
-    clientsTable_->setHorizontalHeaderLabels({"Client ID", "IP", "Port", "Status"});
+    clientsTable_->setColumnCount(5);
+    clientsTable_->setHorizontalHeaderLabels({"Client ID", "IP", "Port", "Status", "UDP loss"});
     mainLayout->addWidget(clientsTable_);
 
+    // filter bar, queries run against the message index
+    QHBoxLayout *filterBar = new QHBoxLayout;
+    clientFilter_ = new QLineEdit;
+    clientFilter_->setPlaceholderText("Client ID");
+    typeFilter_ = new QComboBox;
+    typeFilter_->addItems({"", "NetworkMetrics", "DeviceStatus", "Log"});
+    severityFilter_ = new QComboBox;
+    severityFilter_->addItems({"", "INFO", "WARNING", "ERROR"});
+    lastMinutesFilter_ = new QSpinBox;
+    lastMinutesFilter_->setRange(0, 100000);
+    lastMinutesFilter_->setSpecialValueText("All time");
+    lastMinutesFilter_->setSuffix(" min");
+    textFilter_ = new QLineEdit;
+    textFilter_->setPlaceholderText("Log words");
+    filterBtn_ = new QPushButton("Filter");
+    filterStatus_ = new QLabel;
+    filterBar->addWidget(clientFilter_);
+    filterBar->addWidget(typeFilter_);
+    filterBar->addWidget(severityFilter_);
+    filterBar->addWidget(lastMinutesFilter_);
+    filterBar->addWidget(textFilter_);
+    filterBar->addWidget(filterBtn_);
+    filterBar->addWidget(filterStatus_);
+    mainLayout->addLayout(filterBar);
+
     // data table
-    dataTable_ = new QTableWidget;
-    dataTable_->setColumnCount(4);
-    dataTable_->setHorizontalHeaderLabels({"Client ID", "Type", "Content", "Time"});
+    dataModel_ = new MessageTableModel(this);
+    dataTable_ = new QTableView;
+    dataTable_->setModel(dataModel_);
     dataTable_->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    dataTable_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
     mainLayout->addWidget(dataTable_);
 
+    // live chart of one metric of one client
+    QHBoxLayout *chartBar = new QHBoxLayout;
+    chartClient_ = new QComboBox;
+    chartClient_->setMinimumContentsLength(12);
+    chartMetric_ = new QComboBox;
+    chartMetric_->addItem("Latency", "latency");
+    chartMetric_->addItem("Bandwidth", "bandwidth");
+    chartMetric_->addItem("Packet loss", "packet_loss");
+    chartMetric_->addItem("CPU", "cpu_usage");
+    chartMetric_->addItem("Memory", "memory_usage");
+    chartSpan_ = new QComboBox;
+    chartSpan_->addItem("1 min", 60 * 1000);
+    chartSpan_->addItem("10 min", 10 * 60 * 1000);
+    chartSpan_->addItem("1 h", 60 * 60 * 1000);
+    chartSpan_->addItem("6 h", 6 * 60 * 60 * 1000);
+    chartSpan_->addItem("All", 0);
+    chartBar->addWidget(new QLabel("Chart:"));
+    chartBar->addWidget(chartClient_);
+    chartBar->addWidget(chartMetric_);
+    chartBar->addWidget(chartSpan_);
+    chartBar->addStretch();
+    mainLayout->addLayout(chartBar);
+    chart_ = new TimeSeriesChart;
+    mainLayout->addWidget(chart_);
+
     // log view
     logView_ = new QTextEdit;
     logView_->setReadOnly(true);
@@ -69,6 +135,9 @@ void MainWindow::setupUi() {
     statusLabel_ = new QLabel("Stopped");
     mainLayout->addWidget(statusLabel_);
 
+    pipelineLabel_ = new QLabel;
+    mainLayout->addWidget(pipelineLabel_);
+
     setCentralWidget(central);
     setWindowTitle("Server");
 
@@ -77,6 +146,15 @@ void MainWindow::setupUi() {
     connect(startClientsBtn_, &QPushButton::clicked, this, &MainWindow::onSendStartClients);
     connect(stopClientsBtn_, &QPushButton::clicked, this, &MainWindow::onSendStopClients);
     connect(configBtn_, &QPushButton::clicked, this, &MainWindow::onConfigureClients);
+    connect(filterBtn_, &QPushButton::clicked, this, &MainWindow::onApplyFilter);
+    connect(clientFilter_, &QLineEdit::returnPressed, this, &MainWindow::onApplyFilter);
+    connect(textFilter_, &QLineEdit::returnPressed, this, &MainWindow::onApplyFilter);
+    connect(clientsTable_, &QTableWidget::cellDoubleClicked, this, &MainWindow::onClientRowActivated);
+    connect(chartClient_, &QComboBox::currentIndexChanged, this, &MainWindow::onChartSelectionChanged);
+    connect(chartMetric_, &QComboBox::currentIndexChanged, this, &MainWindow::onChartSelectionChanged);
+    connect(chartSpan_, &QComboBox::currentIndexChanged, this, [this] {
+        chart_->setSpan(chartSpan_->currentData().toLongLong());
+    });
 }
 
 void MainWindow::onStartServer() {
@@ -86,14 +164,30 @@ void MainWindow::onStartServer() {
     }
     serverThread_ = new QThread(this);
     serverManager_ = new ServerManager(listenPort_);
+    serverManager_->setShards(shards_);
+    serverManager_->setAllowedFronts(allowedFronts_);
+    serverManager_->setPublishPort(publishPort_);
+    serverManager_->setPublishAllowed(publishAllowed_);
+    serverManager_->setLocalServerName(localName_);
+    serverManager_->setDatagramPort(datagramPort_);
+    serverManager_->setDataAcknowledged(true);
+    registerDisplayProcessors(serverManager_->pipeline()->registry());
     serverManager_->moveToThread(serverThread_);
 
     // forward signals from serverManager_ to GUI
     connect(serverThread_, &QThread::started, serverManager_, &ServerManager::startListening);
     connect(serverManager_, &ServerManager::clientConnected, this, &MainWindow::onClientConnected);
     connect(serverManager_, &ServerManager::clientDisconnected, this, &MainWindow::onClientDisconnected);
-    connect(serverManager_, &ServerManager::dataReceived, this, &MainWindow::onDataReceived);
+    ServerManager *manager = serverManager_;
+    connect(serverManager_, &ServerManager::dataReceived, this,
+            [this, manager](const QString &clientId, const QJsonObject &obj, const QVariantMap &results) {
+        onDataReceived(clientId, obj, results);
+        // the pipeline gets ahead of the table by at most its queue capacity
+        manager->dataConsumed();
+    });
     connect(serverManager_, &ServerManager::logMessage, this, &MainWindow::onLogMessage);
+    connect(serverManager_, &ServerManager::pipelineStats, this, &MainWindow::onPipelineStats);
+    connect(serverManager_, &ServerManager::datagramLoss, this, &MainWindow::onDatagramLoss);
 
     // ensure cleanup when app closes
     connect(this, &MainWindow::destroyed, [this]() {
@@ -101,7 +195,10 @@ void MainWindow::onStartServer() {
     });
 
     serverThread_->start();
-    statusLabel_->setText(QStringLiteral("Listening on port %1").arg(listenPort_));
+    if (shards_.isEmpty())
+        statusLabel_->setText(QStringLiteral("Listening on port %1").arg(listenPort_));
+    else
+        statusLabel_->setText(QStringLiteral("Front node on port %1, %2 shard(s)").arg(listenPort_).arg(shards_.size()));
     logView_->append(QStringLiteral("Server thread started"));
 }
 
@@ -119,9 +216,13 @@ void MainWindow::onStopServer() {
     statusLabel_->setText("Stopped");
     logView_->append("Server stopped");
     clientsTable_->setRowCount(0);
+    for (const QString &id : liveClients_) retireChartClient(id);
+    liveClients_.clear();
+    pipelineLabel_->clear();
 }
 
 void MainWindow::onClientConnected(const QString &clientId, const QString &ip, quint16 port) {
+    liveClients_.insert(clientId);
     int row = clientsTable_->rowCount();
     clientsTable_->insertRow(row);
     clientsTable_->setItem(row, 0, new QTableWidgetItem(clientId));
@@ -132,6 +233,7 @@ void MainWindow::onClientConnected(const QString &clientId, const QString &ip, q
 }
 
 void MainWindow::onClientDisconnected(const QString &clientId) {
+    if (liveClients_.remove(clientId)) retireChartClient(clientId);
     // find in table and mark disconnected (or remove)
     for (int r = 0; r < clientsTable_->rowCount(); ++r) {
         QTableWidgetItem *item = clientsTable_->item(r, 0);
@@ -143,38 +245,104 @@ void MainWindow::onClientDisconnected(const QString &clientId) {
     logView_->append(QStringLiteral("Client disconnected: %1").arg(clientId));
 }
 
-void MainWindow::onDataReceived(const QString &clientId, const QJsonObject &obj) {
-    QString type = obj.value("type").toString();
-    QString content;
-    if (type == "NetworkMetrics") {
-        double bw = obj.value("bandwidth").toDouble();
-        double lat = obj.value("latency").toDouble();
-        double pl = obj.value("packet_loss").toDouble();
-        content = QString("bw=%1 latency=%2 pl=%3").arg(bw).arg(lat).arg(pl);
-    } else if (type == "DeviceStatus") {
-        qint64 uptime = obj.value("uptime").toInt();
-        int cpu = obj.value("cpu_usage").toInt();
-        int mem = obj.value("memory_usage").toInt();
-        content = QString("uptime=%1 cpu=%2 mem=%3").arg(uptime).arg(cpu).arg(mem);
-    } else if (type == "Log") {
-        content = obj.value("message").toString();
-        content = QString("[%1] %2").arg(obj.value("severity").toString()).arg(content);
-    } else {
-        content = QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+void MainWindow::onDataReceived(const QString &clientId, const QJsonObject &obj, const QVariantMap &results) {
+    // formatted by the pipeline processors (DisplayProcessors), nothing to parse here
+    const qint64 timeMs = results.value("time").toLongLong();
+    const QVariantMap samples = results.value("samples").toMap();
+    for (auto it = samples.cbegin(); it != samples.cend(); ++it) {
+        appendSample(clientId, it.key(), timeMs, it.value().toDouble());
     }
+    dataModel_->appendMessage(clientId, obj.value("type").toString(), obj.value("severity").toString(),
+                              timeMs, results.value("content").toString(), results.value("text").toString());
+}
 
-    int row = dataTable_->rowCount();
-    dataTable_->insertRow(row);
-    dataTable_->setItem(row, 0, new QTableWidgetItem(clientId));
-    dataTable_->setItem(row, 1, new QTableWidgetItem(type));
-    dataTable_->setItem(row, 2, new QTableWidgetItem(content));
-    dataTable_->setItem(row, 3, new QTableWidgetItem(QTime::currentTime().toString()));
+void MainWindow::onApplyFilter() {
+    MessageQuery q;
+    q.clientId = clientFilter_->text().trimmed();
+    q.type = typeFilter_->currentText();
+    q.severity = severityFilter_->currentText();
+    if (lastMinutesFilter_->value() > 0)
+        q.fromMs = QDateTime::currentMSecsSinceEpoch() - qint64(lastMinutesFilter_->value()) * 60 * 1000;
+    q.tokens = MessageIndex::tokenize(textFilter_->text());
+
+    QElapsedTimer timer;
+    timer.start();
+    int found = dataModel_->setQuery(q);
+    filterStatus_->setText(QStringLiteral("%1 of %2 rows, %3 ms")
+        .arg(found).arg(dataModel_->totalRows()).arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1));
+}
+
+void MainWindow::onClientRowActivated(int row, int) {
+    QTableWidgetItem *item = clientsTable_->item(row, 0);
+    if (!item) return;
+    clientFilter_->setText(item->text());
+    onApplyFilter();
+    chartClient_->setCurrentText(item->text());
+}
+
+void MainWindow::appendSample(const QString &clientId, const QString &metric, qint64 timeMs, double value) {
+    const QString key = clientId + '/' + metric;
+    TimeSeriesBuffer *buf = series_.value(key);
+    if (!buf) {
+        // stragglers of a client that is already gone do not get a new chart
+        if (!liveClients_.contains(clientId)) return;
+        buf = new TimeSeriesBuffer;
+        series_.insert(key, buf);
+        if (chartClient_->findText(clientId) < 0) chartClient_->addItem(clientId);
+        if (chartClient_->currentText() == clientId && chartMetric_->currentData().toString() == metric)
+            onChartSelectionChanged();
+    }
+    // late backfill is older than what the chart already has and is skipped
+    buf->append(timeMs, value);
+}
+
+void MainWindow::retireChartClient(const QString &clientId) {
+    if (chartClient_->findText(clientId) < 0) return;
+    retiredChartClients_.append(clientId);
+    // every reconnect brings a new id, so keep only the most recent ones
+    while (retiredChartClients_.size() > kKeptDisconnectedCharts)
+        evictChartClient(retiredChartClients_.takeFirst());
+}
+
+void MainWindow::evictChartClient(const QString &clientId) {
+    QList<TimeSeriesBuffer*> dropped;
+    for (int i = 0; i < chartMetric_->count(); ++i) {
+        TimeSeriesBuffer *buf = series_.take(clientId + '/' + chartMetric_->itemData(i).toString());
+        if (buf) dropped.append(buf);
+    }
+    // the chart switches to another series before the buffers go away
+    const int idx = chartClient_->findText(clientId);
+    if (idx >= 0) chartClient_->removeItem(idx);
+    onChartSelectionChanged();
+    qDeleteAll(dropped);
+}
+
+void MainWindow::onChartSelectionChanged() {
+    const QString key = chartClient_->currentText() + '/' + chartMetric_->currentData().toString();
+    chart_->setSeries(series_.value(key), chartClient_->currentText() + ' ' + chartMetric_->currentText());
 }
 
 void MainWindow::onLogMessage(const QString &msg) {
     logView_->append(msg);
 }
 
+void MainWindow::onPipelineStats(const QString &summary) {
+    pipelineLabel_->setText(summary);
+}
+
+void MainWindow::onDatagramLoss(const QString &clientId, quint64 received, quint64 lost, quint64 late) {
+    const quint64 total = received + lost + late;
+    const double pct = total ? 100.0 * lost / total : 0.0;
+    const QString text = QStringLiteral("%1 / %2 (%3%), late %4").arg(lost).arg(total).arg(pct, 0, 'f', 1).arg(late);
+    for (int r = 0; r < clientsTable_->rowCount(); ++r) {
+        QTableWidgetItem *item = clientsTable_->item(r, 0);
+        if (item && item->text() == clientId) {
+            clientsTable_->setItem(r, 4, new QTableWidgetItem(text));
+            break;
+        }
+    }
+}
+
 void MainWindow::onSendStartClients() {
     if (!serverManager_) { QMessageBox::warning(this, "Warning", "Server not running"); return; }
     QJsonObject cmd;
@@ -1,15 +1,30 @@
 #pragma once
 #include <QMainWindow>
 #include <QThread>
+#include <QList>
+#include <QPair>
+#include <QJsonObject>
+#include <QVariantMap>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QHostAddress>
 
 QT_BEGIN_NAMESPACE
 class QTableWidget;
+class QTableView;
 class QPushButton;
 class QTextEdit;
 class QLabel;
+class QLineEdit;
+class QComboBox;
+class QSpinBox;
 QT_END_NAMESPACE
 
 class ServerManager;
+class MessageTableModel;
+class TimeSeriesBuffer;
+class TimeSeriesChart;
 
 class MainWindow : public QMainWindow
 {
@@ -18,22 +33,57 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override;
 
+    void setListenPort(quint16 port) { listenPort_ = port; }
+    // run as front node over these shard processes
+    void setShards(const QList<QPair<QString, quint16>> &shards) { shards_ = shards; }
+    void setAllowedFronts(const QList<QHostAddress> &addrs) { allowedFronts_ = addrs; }
+    void setPublishPort(quint16 port) { publishPort_ = port; }
+    void setPublishAllowed(const QList<QHostAddress> &addrs) { publishAllowed_ = addrs; }
+    void setLocalServerName(const QString &name) { localName_ = name; }
+    void setDatagramPort(quint16 port) { datagramPort_ = port; }
+
 private slots:
     void onStartServer();
     void onStopServer();
     void onClientConnected(const QString &clientId, const QString &ip, quint16 port);
     void onClientDisconnected(const QString &clientId);
-    void onDataReceived(const QString &clientId, const QJsonObject &obj);
+    void onDataReceived(const QString &clientId, const QJsonObject &obj, const QVariantMap &results);
     void onLogMessage(const QString &msg);
+    void onPipelineStats(const QString &summary);
+    void onDatagramLoss(const QString &clientId, quint64 received, quint64 lost, quint64 late);
     void onSendStartClients();
     void onSendStopClients();
     void onConfigureClients();
+    void onApplyFilter();
+    void onClientRowActivated(int row, int column);
+    void onChartSelectionChanged();
 
 private:
     void setupUi();
+    void appendSample(const QString &clientId, const QString &metric, qint64 timeMs, double value);
+    void retireChartClient(const QString &clientId);
+    void evictChartClient(const QString &clientId);
 
     QTableWidget *clientsTable_;
-    QTableWidget *dataTable_;
+    QTableView *dataTable_;
+    MessageTableModel *dataModel_;
+    QLineEdit *clientFilter_;
+    QComboBox *typeFilter_;
+    QComboBox *severityFilter_;
+    QSpinBox *lastMinutesFilter_;
+    QLineEdit *textFilter_;
+    QPushButton *filterBtn_;
+    QLabel *filterStatus_;
+    QComboBox *chartClient_;
+    QComboBox *chartMetric_;
+    QComboBox *chartSpan_;
+    TimeSeriesChart *chart_;
+    // "client/metric" -> history. charts are created for connected clients
+    // only and kept for the last kKeptDisconnectedCharts after they leave
+    QHash<QString, TimeSeriesBuffer*> series_;
+    QSet<QString> liveClients_;
+    QStringList retiredChartClients_;
+    static const int kKeptDisconnectedCharts = 8;
     QPushButton *startServerBtn_;
     QPushButton *stopServerBtn_;
     QPushButton *startClientsBtn_;
@@ -41,10 +91,17 @@ private:
     QPushButton *configBtn_;
     QTextEdit *logView_;
     QLabel *statusLabel_;
+    QLabel *pipelineLabel_;
 
     ServerManager *serverManager_;
     QThread *serverThread_;
     quint16 listenPort_;
+    quint16 publishPort_;
+    quint16 datagramPort_;
+    QString localName_;
+    QList<QPair<QString, quint16>> shards_;
+    QList<QHostAddress> allowedFronts_;
+    QList<QHostAddress> publishAllowed_;
 };
 
 
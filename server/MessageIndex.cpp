@@ -0,0 +1,155 @@
+#include "MessageIndex.h"
+#include <QSet>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+int MessageIndex::intern(QStringList &names, QHash<QString, int> &ids, const QString &s) {
+    auto it = ids.constFind(s);
+    if (it != ids.constEnd()) return it.value();
+    const int id = names.size();
+    names.append(s);
+    ids.insert(s, id);
+    return id;
+}
+
+QStringList MessageIndex::tokenize(const QString &text) {
+    QStringList out;
+    QSet<QString> seen;
+    QString cur;
+    auto flush = [&]() {
+        if (cur.size() >= 2 && !seen.contains(cur)) {
+            seen.insert(cur);
+            out.append(cur);
+        }
+        cur.clear();
+    };
+    for (const QChar ch : text) {
+        if (ch.isLetterOrNumber()) {
+            cur.append(ch.toLower());
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return out;
+}
+
+int MessageIndex::append(const QString &clientId, const QString &type, const QString &severity,
+                         qint64 timeMs, const QString &content, const QString &text) {
+    StoredMessage m;
+    m.timeMs = timeMs;
+    m.client = intern(clients_, clientIds_, clientId);
+    m.type = intern(types_, typeIds_, type);
+    m.severity = intern(severities_, severityIds_, severity);
+    m.content = content;
+
+    const quint32 row = static_cast<quint32>(rows_.size());
+    if (byClient_.size() <= m.client) byClient_.resize(m.client + 1);
+    if (byType_.size() <= m.type) byType_.resize(m.type + 1);
+    if (bySeverity_.size() <= m.severity) bySeverity_.resize(m.severity + 1);
+    byClient_[m.client].append(row);
+    byType_[m.type].append(row);
+    bySeverity_[m.severity].append(row);
+    byBucket_[timeMs / kBucketMs].append(row);
+    if (type == "Log") {
+        for (const QString &tok : tokenize(text)) byToken_[tok].append(row);
+    }
+
+    rows_.append(std::move(m));
+    return static_cast<int>(row);
+}
+
+void MessageIndex::clear() {
+    *this = MessageIndex();
+}
+
+QVector<quint32> MessageIndex::intersect(const QVector<quint32> &a, const QVector<quint32> &b) {
+    // walk the shorter list, binary-search forward in the longer one
+    const QVector<quint32> &small = a.size() <= b.size() ? a : b;
+    const QVector<quint32> &large = a.size() <= b.size() ? b : a;
+    QVector<quint32> out;
+    out.reserve(small.size());
+    auto pos = large.cbegin();
+    for (quint32 v : small) {
+        pos = std::lower_bound(pos, large.cend(), v);
+        if (pos == large.cend()) break;
+        if (*pos == v) out.append(v);
+    }
+    return out;
+}
+
+QVector<quint32> MessageIndex::search(const MessageQuery &q) const {
+    QVector<quint32> result;
+    if (q.isEmpty()) {
+        result.resize(rows_.size());
+        std::iota(result.begin(), result.end(), 0u);
+        return result;
+    }
+
+    QVector<const QVector<quint32>*> lists;
+    auto addList = [&](const QHash<QString, int> &ids, const QVector<QVector<quint32>> &postings,
+                       const QString &key) {
+        auto it = ids.constFind(key);
+        if (it == ids.constEnd()) return false;
+        lists.append(&postings.at(it.value()));
+        return true;
+    };
+    if (!q.clientId.isEmpty() && !addList(clientIds_, byClient_, q.clientId)) return result;
+    if (!q.type.isEmpty() && !addList(typeIds_, byType_, q.type)) return result;
+    if (!q.severity.isEmpty() && !addList(severityIds_, bySeverity_, q.severity)) return result;
+    for (const QString &tok : q.tokens) {
+        auto it = byToken_.constFind(tok.toLower());
+        if (it == byToken_.constEnd()) return result;
+        lists.append(&it.value());
+    }
+
+    // buckets are walked in time order, which is row order unless backfilled
+    // rows with old timestamps are mixed in; only then a sort is needed
+    const bool timed = q.fromMs >= 0 || q.toMs >= 0;
+    QVector<quint32> timeRows;
+    if (timed) {
+        auto it = q.fromMs >= 0 ? byBucket_.lowerBound(q.fromMs / kBucketMs) : byBucket_.constBegin();
+        const qint64 hi = q.toMs >= 0 ? q.toMs / kBucketMs : std::numeric_limits<qint64>::max();
+        for (; it != byBucket_.constEnd() && it.key() <= hi; ++it) timeRows += it.value();
+        if (!std::is_sorted(timeRows.cbegin(), timeRows.cend())) {
+            std::sort(timeRows.begin(), timeRows.end());
+        }
+        lists.append(&timeRows);
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const QVector<quint32> *a, const QVector<quint32> *b) {
+        return a->size() < b->size();
+    });
+    result = *lists.first();
+    for (int i = 1; i < lists.size() && !result.isEmpty(); ++i) {
+        result = intersect(result, *lists.at(i));
+    }
+
+    if (timed) {
+        // bucket granularity is a minute, trim the edges exactly
+        result.erase(std::remove_if(result.begin(), result.end(), [&](quint32 row) {
+            const qint64 t = rows_.at(row).timeMs;
+            return (q.fromMs >= 0 && t < q.fromMs) || (q.toMs >= 0 && t > q.toMs);
+        }), result.end());
+    }
+    return result;
+}
+
+bool MessageIndex::matches(int row, const MessageQuery &q) const {
+    const StoredMessage &m = rows_.at(row);
+    if (!q.clientId.isEmpty() && clients_.at(m.client) != q.clientId) return false;
+    if (!q.type.isEmpty() && types_.at(m.type) != q.type) return false;
+    if (!q.severity.isEmpty() && severities_.at(m.severity) != q.severity) return false;
+    if (q.fromMs >= 0 && m.timeMs < q.fromMs) return false;
+    if (q.toMs >= 0 && m.timeMs > q.toMs) return false;
+    if (!q.tokens.isEmpty()) {
+        // posting lists are sorted, so membership is a binary search
+        for (const QString &t : q.tokens) {
+            auto it = byToken_.constFind(t.toLower());
+            if (it == byToken_.constEnd() ||
+                !std::binary_search(it->cbegin(), it->cend(), static_cast<quint32>(row))) return false;
+        }
+    }
+    return true;
+}
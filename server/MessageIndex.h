@@ -0,0 +1,78 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+
+// one row of received history
+struct StoredMessage {
+    qint64 timeMs;
+    int client;     // interned ids, see MessageIndex::clientName() etc.
+    int type;
+    int severity;
+    QString content;
+};
+
+// empty/negative fields are not filtered on; tokens must all be present
+struct MessageQuery {
+    QString clientId;
+    QString type;
+    QString severity;
+    qint64 fromMs = -1;
+    qint64 toMs = -1;
+    QStringList tokens;
+
+    bool isEmpty() const {
+        return clientId.isEmpty() && type.isEmpty() && severity.isEmpty() &&
+               fromMs < 0 && toMs < 0 && tokens.isEmpty();
+    }
+};
+
+// append-only message store with posting lists per client, type, severity,
+// minute bucket and Log text token. row ids only grow, so every posting list
+// stays sorted without extra work and a query is an intersection of lists.
+class MessageIndex
+{
+public:
+    static const qint64 kBucketMs = 60 * 1000;
+
+    // content is what the table shows, text is what gets tokenized (the
+    // raw Log message, without severity or other decoration)
+    int append(const QString &clientId, const QString &type, const QString &severity,
+               qint64 timeMs, const QString &content, const QString &text);
+    void clear();
+
+    int size() const { return rows_.size(); }
+    const StoredMessage &at(int row) const { return rows_.at(row); }
+    QString clientName(int id) const { return clients_.at(id); }
+    QString typeName(int id) const { return types_.at(id); }
+    QString severityName(int id) const { return severities_.at(id); }
+
+    // ids of matching rows in insertion order
+    QVector<quint32> search(const MessageQuery &q) const;
+    // check a single row, used to extend an active filter with new rows
+    bool matches(int row, const MessageQuery &q) const;
+
+    // distinct lower-cased words of two or more letters/digits. no cap on
+    // their number: a word left out of the index could never match
+    static QStringList tokenize(const QString &text);
+
+private:
+    static int intern(QStringList &names, QHash<QString, int> &ids, const QString &s);
+    static QVector<quint32> intersect(const QVector<quint32> &a, const QVector<quint32> &b);
+
+    QVector<StoredMessage> rows_;
+    QStringList clients_;
+    QStringList types_;
+    QStringList severities_;
+    QHash<QString, int> clientIds_;
+    QHash<QString, int> typeIds_;
+    QHash<QString, int> severityIds_;
+
+    QVector<QVector<quint32>> byClient_;
+    QVector<QVector<quint32>> byType_;
+    QVector<QVector<quint32>> bySeverity_;
+    QMap<qint64, QVector<quint32>> byBucket_;
+    QHash<QString, QVector<quint32>> byToken_;
+};
@@ -0,0 +1,210 @@
+#include "MessagePipeline.h"
+#include <QJsonDocument>
+#include <QStringList>
+
+MessagePipeline::MessagePipeline(int workers, int queueCapacity, QObject *parent)
+    : QObject(parent),
+    decode_(QStringLiteral("decode"), queueCapacity),
+    validate_(QStringLiteral("validate"), queueCapacity),
+    route_(QStringLiteral("route"), queueCapacity),
+    running_(false),
+    credits_(queueCapacity),
+    statsTimer_(this)
+{
+    if (workers <= 0) workers = qBound(1, QThread::idealThreadCount() / 2, 4);
+    for (int i = 0; i < workers; ++i) {
+        workers_.append(new Stage<Routed>(QStringLiteral("proc%1").arg(i), queueCapacity));
+    }
+    connect(&statsTimer_, &QTimer::timeout, this, &MessagePipeline::onStatsTick);
+    statsTimer_.setInterval(1000);
+}
+
+MessagePipeline::~MessagePipeline() {
+    stop();
+    qDeleteAll(workers_);
+}
+
+void MessagePipeline::start() {
+    if (running_) return;
+    running_ = true;
+    stopping_ = false;
+
+    decode_.queue.reset();
+    validate_.queue.reset();
+    route_.queue.reset();
+    decode_.thread = QThread::create([this] { runDecode(); });
+    validate_.thread = QThread::create([this] { runValidate(); });
+    route_.thread = QThread::create([this] { runRoute(); });
+    decode_.thread->start();
+    validate_.thread->start();
+    route_.thread->start();
+    for (Stage<Routed> *w : workers_) {
+        w->queue.reset();
+        w->thread = QThread::create([this, w] { runWorker(w); });
+        w->thread->start();
+    }
+
+    statsClock_.start();
+    statsTimer_.start();
+}
+
+void MessagePipeline::stop() {
+    if (!running_) return;
+    running_ = false;
+    stopping_ = true;
+    statsTimer_.stop();
+
+    // close front to back: a queue is closed only after the stage feeding it
+    // has finished, so messages already accepted are still delivered
+    auto finish = [](auto &stage) {
+        stage.queue.close();
+        stage.thread->wait();
+        delete stage.thread;
+        stage.thread = nullptr;
+    };
+    finish(decode_);
+    finish(validate_);
+    finish(route_);
+    for (Stage<Routed> *w : workers_) finish(*w);
+}
+
+PipelineMessage MessagePipeline::makeMessage(const QString &clientId, const QByteArray &payload, const QJsonObject &obj) {
+    PipelineMessage msg;
+    msg.clientId = clientId;
+    msg.payload = payload;
+    if (!obj.isEmpty()) {
+        msg.obj = obj;
+        msg.decoded = true;
+    }
+    return msg;
+}
+
+void MessagePipeline::submit(const QString &clientId, const QByteArray &payload, const QJsonObject &obj) {
+    decode_.queue.push(makeMessage(clientId, payload, obj));
+}
+
+bool MessagePipeline::trySubmit(const QString &clientId, const QByteArray &payload, const QJsonObject &obj) {
+    return decode_.queue.tryPush(makeMessage(clientId, payload, obj));
+}
+
+bool MessagePipeline::hasRoom() const {
+    return decode_.queue.size() <= decode_.queue.capacity() / 2;
+}
+
+void MessagePipeline::releaseDelivery() {
+    int owed = uncredited_.load();
+    while (owed > 0) {
+        if (uncredited_.compare_exchange_weak(owed, owed - 1)) return;
+    }
+    credits_.release();
+}
+
+void MessagePipeline::runDecode() {
+    PipelineMessage msg;
+    while (decode_.queue.pop(msg)) {
+        if (!msg.decoded) {
+            QJsonParseError err;
+            QJsonDocument doc = QJsonDocument::fromJson(msg.payload, &err);
+            if (err.error != QJsonParseError::NoError || !doc.isObject()) {
+                ++rejected_;
+                emit rejected(msg.clientId, QStringLiteral("invalid JSON"));
+                continue;
+            }
+            msg.obj = doc.object();
+            msg.decoded = true;
+        }
+        msg.type = msg.obj.value("type").toString();
+        ++decode_.processed;
+        validate_.queue.push(std::move(msg));
+    }
+}
+
+void MessagePipeline::runValidate() {
+    PipelineMessage msg;
+    QString reason;
+    while (validate_.queue.pop(msg)) {
+        if (!validate(msg, reason)) {
+            ++rejected_;
+            emit rejected(msg.clientId, reason);
+            continue;
+        }
+        ++validate_.processed;
+        route_.queue.push(std::move(msg));
+    }
+}
+
+void MessagePipeline::runRoute() {
+    Routed routed;
+    while (route_.queue.pop(routed.msg)) {
+        routed.processors = registry_.processorsFor(routed.msg.type);
+        // same client -> same worker, keeps per-client order
+        const int idx = static_cast<int>(qHash(routed.msg.clientId) % static_cast<uint>(workers_.size()));
+        ++route_.processed;
+        workers_.at(idx)->queue.push(std::move(routed));
+    }
+}
+
+void MessagePipeline::runWorker(Stage<Routed> *stage) {
+    Routed routed;
+    while (stage->queue.pop(routed)) {
+        for (const auto &p : routed.processors) {
+            p->process(routed.msg);
+        }
+        ++stage->processed;
+        // wait for the consumer to catch up. stop() runs on the consuming
+        // thread, which then releases nothing, so messages drained while
+        // stopping go out on credit
+        bool credited = false;
+        while (!(credited = credits_.tryAcquire(1, 50)) && !stopping_) {}
+        if (!credited) ++uncredited_;
+        emit delivered(routed.msg.clientId, routed.msg.obj, routed.msg.payload, routed.msg.results);
+    }
+}
+
+bool MessagePipeline::validate(const PipelineMessage &msg, QString &reason) {
+    const QJsonObject &o = msg.obj;
+    auto need = [&](const char *field, bool ok) {
+        if (!ok) reason = QStringLiteral("%1: bad or missing '%2'").arg(msg.type, QLatin1String(field));
+        return ok;
+    };
+    if (msg.type.isEmpty()) {
+        reason = QStringLiteral("missing type");
+        return false;
+    }
+    if (msg.type == "NetworkMetrics") {
+        return need("bandwidth", o.value("bandwidth").isDouble()) &&
+               need("latency", o.value("latency").isDouble()) &&
+               need("packet_loss", o.value("packet_loss").isDouble());
+    }
+    if (msg.type == "DeviceStatus") {
+        return need("uptime", o.value("uptime").isDouble()) &&
+               need("cpu_usage", o.value("cpu_usage").isDouble()) &&
+               need("memory_usage", o.value("memory_usage").isDouble());
+    }
+    if (msg.type == "Log") {
+        return need("message", o.value("message").isString()) &&
+               need("severity", o.value("severity").isString());
+    }
+    return true;
+}
+
+template <typename T>
+QString MessagePipeline::describe(Stage<T> *stage, double secs) {
+    const quint64 now = stage->processed.load();
+    const double rate = secs > 0 ? (now - stage->lastProcessed) / secs : 0.0;
+    stage->lastProcessed = now;
+    return QStringLiteral("%1 q=%2/%3 %4/s")
+        .arg(stage->name)
+        .arg(stage->queue.size())
+        .arg(stage->queue.capacity())
+        .arg(rate, 0, 'f', 0);
+}
+
+void MessagePipeline::onStatsTick() {
+    const double secs = statsClock_.restart() / 1000.0;
+    QStringList parts;
+    parts << describe(&decode_, secs) << describe(&validate_, secs) << describe(&route_, secs);
+    for (Stage<Routed> *w : workers_) parts << describe(w, secs);
+    parts << QStringLiteral("rejected %1").arg(rejected_.load());
+    emit statsUpdated(parts.join(QStringLiteral(" | ")));
+}
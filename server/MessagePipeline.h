@@ -0,0 +1,97 @@
+#pragma once
+#include <QObject>
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <atomic>
+#include "BoundedQueue.h"
+#include "MessageProcessor.h"
+
+// decode -> validate -> route -> processors, each stage on its own thread(s)
+// with bounded queues in between. a full queue blocks the stage before it;
+// the decode queue never blocks, callers pause their input when trySubmit()
+// fails and resume once hasRoom(), so overload ends up as TCP backpressure
+// instead of unbounded memory.
+// after its processors, every valid message is handed back through delivered()
+// together with whatever the processors put into its results. each delivered()
+// holds one of queueCapacity credits until releaseDelivery(), so a slow
+// consumer stalls the workers rather than piling up queued signals.
+class MessagePipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessagePipeline(int workers = 0, int queueCapacity = 4096, QObject *parent = nullptr);
+    ~MessagePipeline() override;
+
+    // register before start()
+    ProcessorRegistry &registry() { return registry_; }
+
+    void start();
+    void stop();
+    bool isRunning() const { return running_; }
+
+    // thread-safe; blocks when the decode queue is full.
+    // obj may be passed when the message is already decoded (payload may then be empty)
+    void submit(const QString &clientId, const QByteArray &payload, const QJsonObject &obj = QJsonObject());
+    // same, but returns false instead of waiting when the decode queue is full;
+    // the caller keeps the message and holds back its input until hasRoom()
+    bool trySubmit(const QString &clientId, const QByteArray &payload, const QJsonObject &obj = QJsonObject());
+    // decode queue at most half full; the gap keeps paused inputs from flapping
+    bool hasRoom() const;
+
+    // thread-safe; call once per delivered() when done with the message
+    void releaseDelivery();
+
+signals:
+    void delivered(const QString &clientId, const QJsonObject &obj, const QByteArray &payload,
+                   const QVariantMap &results);
+    void rejected(const QString &clientId, const QString &reason);
+    // one line per stage: queue depth/capacity and messages per second
+    void statsUpdated(const QString &summary);
+
+private slots:
+    void onStatsTick();
+
+private:
+    struct Routed {
+        PipelineMessage msg;
+        QList<std::shared_ptr<MessageProcessor>> processors;
+    };
+
+    template <typename T>
+    struct Stage {
+        Stage(const QString &n, int capacity) : name(n), queue(capacity) {}
+        QString name;
+        BoundedQueue<T> queue;
+        std::atomic<quint64> processed{0};
+        quint64 lastProcessed = 0;
+        QThread *thread = nullptr;
+    };
+
+    void runDecode();
+    void runValidate();
+    void runRoute();
+    void runWorker(Stage<Routed> *stage);
+    static bool validate(const PipelineMessage &msg, QString &reason);
+    static PipelineMessage makeMessage(const QString &clientId, const QByteArray &payload, const QJsonObject &obj);
+
+    template <typename T>
+    QString describe(Stage<T> *stage, double secs);
+
+    ProcessorRegistry registry_;
+    Stage<PipelineMessage> decode_;
+    Stage<PipelineMessage> validate_;
+    Stage<PipelineMessage> route_;
+    QList<Stage<Routed>*> workers_;
+
+    bool running_;
+    std::atomic<bool> stopping_{false};
+    QSemaphore credits_;
+    // delivered while stopping without a credit, settled by the next releases
+    std::atomic<int> uncredited_{0};
+    QTimer statsTimer_;
+    QElapsedTimer statsClock_;
+    std::atomic<quint64> rejected_{0};
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QVariantMap>
+#include <QHash>
+#include <QList>
+#include <functional>
+#include <memory>
+
+// one received message as it moves through the pipeline
+struct PipelineMessage {
+    QString clientId;
+    QByteArray payload;   // original frame body, may be empty for forwarded data
+    QJsonObject obj;      // filled by decode
+    QString type;
+    bool decoded = false;
+    // filled by processors (display text, chart samples, alerts...),
+    // handed on together with the message by MessagePipeline::delivered()
+    QVariantMap results;
+};
+
+// pluggable processing step (formatting, aggregation, alerting, persistence...).
+// process() runs on a pipeline worker thread; messages of one client always
+// reach a processor in order and from the same thread. results go into msg.results.
+class MessageProcessor
+{
+public:
+    virtual ~MessageProcessor() = default;
+    virtual QString name() const = 0;
+    virtual void process(PipelineMessage &msg) = 0;
+};
+
+// adapter for small processors written as a lambda
+class FunctionProcessor : public MessageProcessor
+{
+public:
+    FunctionProcessor(const QString &name, std::function<void(PipelineMessage &)> fn)
+        : name_(name), fn_(std::move(fn)) {}
+    QString name() const override { return name_; }
+    void process(PipelineMessage &msg) override { fn_(msg); }
+
+private:
+    QString name_;
+    std::function<void(PipelineMessage &)> fn_;
+};
+
+// processors indexed by message type, "*" receives every type (after the
+// type-specific ones).
+// fill it before the pipeline starts; it is read without locking afterwards.
+class ProcessorRegistry
+{
+public:
+    static QString anyType() { return QStringLiteral("*"); }
+
+    void registerProcessor(const QString &type, std::shared_ptr<MessageProcessor> processor) {
+        byType_[type].append(std::move(processor));
+    }
+
+    QList<std::shared_ptr<MessageProcessor>> processorsFor(const QString &type) const {
+        return byType_.value(type) + byType_.value(anyType());
+    }
+
+private:
+    QHash<QString, QList<std::shared_ptr<MessageProcessor>>> byType_;
+};
@@ -0,0 +1,87 @@
+#include "MessageTableModel.h"
+#include <QDateTime>
+
+MessageTableModel::MessageTableModel(QObject *parent)
+    : QAbstractTableModel(parent),
+    filtered_(false),
+    shownRows_(0),
+    flushTimer_(this)
+{
+    flushTimer_.setSingleShot(true);
+    flushTimer_.setInterval(100);
+    connect(&flushTimer_, &QTimer::timeout, this, &MessageTableModel::flushPending);
+}
+
+int MessageTableModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return filtered_ ? view_.size() : shownRows_;
+}
+
+int MessageTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : 4;
+}
+
+int MessageTableModel::storeRow(int viewRow) const {
+    return filtered_ ? static_cast<int>(view_.at(viewRow)) : viewRow;
+}
+
+QVariant MessageTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole) return QVariant();
+    const StoredMessage &m = index_.at(storeRow(index.row()));
+    switch (index.column()) {
+    case 0: return index_.clientName(m.client);
+    case 1: return index_.typeName(m.type);
+    case 2: return m.content;
+    case 3: return QDateTime::fromMSecsSinceEpoch(m.timeMs).time().toString();
+    }
+    return QVariant();
+}
+
+QVariant MessageTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) return QVariant();
+    static const char *names[] = {"Client ID", "Type", "Content", "Time"};
+    return (section >= 0 && section < 4) ? QString(names[section]) : QVariant();
+}
+
+void MessageTableModel::appendMessage(const QString &clientId, const QString &type, const QString &severity,
+                                      qint64 timeMs, const QString &content, const QString &text) {
+    const int row = index_.append(clientId, type, severity, timeMs, content, text);
+    if (filtered_ && index_.matches(row, query_)) pendingMatches_.append(static_cast<quint32>(row));
+    if (!flushTimer_.isActive()) flushTimer_.start();
+}
+
+void MessageTableModel::flushPending() {
+    if (filtered_) {
+        if (pendingMatches_.isEmpty()) return;
+        beginInsertRows(QModelIndex(), view_.size(), view_.size() + pendingMatches_.size() - 1);
+        view_ += pendingMatches_;
+        endInsertRows();
+        pendingMatches_.clear();
+        shownRows_ = index_.size();
+        return;
+    }
+    if (shownRows_ == index_.size()) return;
+    beginInsertRows(QModelIndex(), shownRows_, index_.size() - 1);
+    shownRows_ = index_.size();
+    endInsertRows();
+}
+
+int MessageTableModel::setQuery(const MessageQuery &q) {
+    beginResetModel();
+    pendingMatches_.clear();
+    shownRows_ = index_.size();
+    query_ = q;
+    filtered_ = !q.isEmpty();
+    view_ = filtered_ ? index_.search(q) : QVector<quint32>();
+    endResetModel();
+    return rowCount();
+}
+
+void MessageTableModel::clear() {
+    beginResetModel();
+    index_.clear();
+    view_.clear();
+    pendingMatches_.clear();
+    shownRows_ = 0;
+    endResetModel();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QTimer>
+#include "MessageIndex.h"
+
+// table view over MessageIndex, optionally restricted by a query.
+// rows arriving between view updates are inserted in one batch.
+class MessageTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit MessageTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void appendMessage(const QString &clientId, const QString &type, const QString &severity,
+                       qint64 timeMs, const QString &content, const QString &text);
+    // returns the number of matching rows
+    int setQuery(const MessageQuery &q);
+    void clear();
+    int totalRows() const { return index_.size(); }
+
+private slots:
+    void flushPending();
+
+private:
+    int storeRow(int viewRow) const;
+
+    MessageIndex index_;
+    MessageQuery query_;
+    bool filtered_;
+    QVector<quint32> view_;
+    // rows stored in index_ but not yet announced to the view
+    int shownRows_;
+    QVector<quint32> pendingMatches_;
+    QTimer flushTimer_;
+};
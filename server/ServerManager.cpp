@@ -1,23 +1,78 @@
 #include "ServerManager.h"
 #include "ClientConnection.h"
+#include "ShardLink.h"
+#include "TelemetryPublisher.h"
+#include "MessagePipeline.h"
+#include "DatagramReceiver.h"
 #include "MessageFraming.h"
 #include <QThread>
 #include <QTcpSocket>
 #include <QJsonObject>
+#include <QJsonDocument>
 
 ServerManager::ServerManager(quint16 port, QObject *parent)
     : QObject(parent),
     server_(new QTcpServer(this)),
-    port_(port)
+    port_(port),
+    localServer_(new QLocalServer(this)),
+    datagrams_(nullptr),
+    datagramPort_(0),
+    nextShard_(0),
+    publishPort_(0),
+    resumeTimer_(new QTimer(this)),
+    dataAcknowledged_(false),
+    publisher_(nullptr),
+    publisherThread_(nullptr)
 {
+    pipeline_ = new MessagePipeline(0, 4096, this);
+    resumeTimer_->setInterval(5);
+    connect(resumeTimer_, &QTimer::timeout, this, &ServerManager::resumePaused);
     connect(server_, &QTcpServer::newConnection, this, &ServerManager::onNewConnection);
+    connect(localServer_, &QLocalServer::newConnection, this, &ServerManager::onNewLocalConnection);
+    connect(pipeline_, &MessagePipeline::delivered, this, &ServerManager::onPipelineMessage);
+    connect(pipeline_, &MessagePipeline::rejected, this, &ServerManager::onPipelineRejected);
+    connect(pipeline_, &MessagePipeline::statsUpdated, this, &ServerManager::pipelineStats);
+    datagrams_ = new DatagramReceiver(pipeline_, this);
+    connect(datagrams_, &DatagramReceiver::lossUpdated, this, &ServerManager::datagramLoss);
+    connect(datagrams_, &DatagramReceiver::logMessage, this, &ServerManager::logMessage);
 }
 
 ServerManager::~ServerManager() {
     stopListening();
 }
 
+void ServerManager::setShards(const QList<QPair<QString, quint16>> &shards) {
+    shardAddrs_ = shards;
+}
+
 void ServerManager::startListening() {
+    if(isFront() && shards_.isEmpty()) {
+        for(const auto &addr : shardAddrs_) {
+            ShardLink *link = new ShardLink(addr.first, addr.second, this);
+            connect(link, &ShardLink::clientConnected, this, &ServerManager::clientConnected);
+            connect(link, &ShardLink::clientDisconnected, this, &ServerManager::clientDisconnected);
+            connect(link, &ShardLink::dataReceived, this,
+                    [this, link](const QString &clientId, const QJsonObject &obj, const QByteArray &payload) {
+                onShardData(link, clientId, obj, payload);
+            });
+            connect(link, &ShardLink::logMessage, this, &ServerManager::logMessage);
+            shards_.append(link);
+            link->start();
+        }
+        emit logMessage(QStringLiteral("Front node for %1 shard(s)").arg(shards_.size()));
+    }
+    if(publishPort_ != 0 && !publisher_) {
+        publisherThread_ = new QThread;
+        publisher_ = new TelemetryPublisher(publishPort_);
+        publisher_->setAllowedPeers(publishAllowed_);
+        publisher_->moveToThread(publisherThread_);
+        connect(publisherThread_, &QThread::started, publisher_, &TelemetryPublisher::start);
+        connect(publisherThread_, &QThread::finished, publisher_, &QObject::deleteLater);
+        connect(publisher_, &TelemetryPublisher::logMessage, this, &ServerManager::logMessage);
+        connect(this, &ServerManager::frameReceived, publisher_, &TelemetryPublisher::publish);
+        publisherThread_->start();
+    }
+    pipeline_->start();
     if(!server_->isListening()) {
         if(server_->listen(QHostAddress::Any, port_)) {
             emit logMessage(QStringLiteral("Server listening on port %1").arg(port_));
@@ -26,12 +81,52 @@ void ServerManager::startListening() {
             emit logMessage(QStringLiteral("Failed to listen on port %1 : %2").arg(port_).arg(server_->errorString()));
         }
     }
+    if(!isFront() && datagramPort_ != 0 && datagrams_->port() == 0) {
+        if(datagrams_->bind(datagramPort_)) {
+            emit logMessage(QStringLiteral("Telemetry datagrams on udp port %1").arg(datagramPort_));
+        }
+        else {
+            emit logMessage(QStringLiteral("Failed to bind udp port %1 : %2").arg(datagramPort_).arg(datagrams_->errorString()));
+        }
+    }
+    // the front node only redirects, local clients talk to a shard directly
+    if(!isFront() && !localName_.isEmpty() && !localServer_->isListening()) {
+        QLocalServer::removeServer(localName_);
+        if(localServer_->listen(localName_)) {
+            emit logMessage(QStringLiteral("Server listening on local socket %1").arg(localServer_->fullServerName()));
+        }
+        else {
+            emit logMessage(QStringLiteral("Failed to listen on local socket %1 : %2").arg(localName_).arg(localServer_->errorString()));
+        }
+    }
 }
 
 void ServerManager::stopListening() {
     if(server_->isListening()) {
         server_->close();
     }
+    if(localServer_->isListening()) {
+        localServer_->close();
+    }
+    datagrams_->close();
+
+    for(ShardLink *link : shards_) {
+        link->stop();
+        link->deleteLater();
+    }
+    shards_.clear();
+    pipeline_->stop();
+    resumeTimer_->stop();
+    pausedClients_.clear();
+
+    if(publisher_) {
+        QMetaObject::invokeMethod(publisher_, "stop", Qt::BlockingQueuedConnection);
+        publisherThread_->quit();
+        publisherThread_->wait();
+        delete publisherThread_;
+        publisherThread_ = nullptr;
+        publisher_ = nullptr;
+    }
 
     QMutexLocker loccker(&mutex_);
     for (auto c : clients_) {
@@ -40,36 +135,173 @@ void ServerManager::stopListening() {
         }
     }
     clients_.clear();
+    for (auto c : upstreams_) {
+        QMetaObject::invokeMethod(c, "deleteLater", Qt::QueuedConnection);
+    }
+    upstreams_.clear();
     emit logMessage("Server stopped");
 }
 
 void ServerManager::onNewConnection() {
     while (server_->hasPendingConnections()) {
         QTcpSocket *sock = server_->nextPendingConnection();
-        ClientConnection *cc = new ClientConnection(sock);
+        if(isFront()) {
+            redirectToShard(sock);
+            continue;
+        }
+        addClient(new ClientConnection(sock));
+    }
+}
+
+void ServerManager::onNewLocalConnection() {
+    while (localServer_->hasPendingConnections()) {
+        addClient(new ClientConnection(localServer_->nextPendingConnection()));
+    }
+}
+
+void ServerManager::addClient(ClientConnection *cc) {
+    connect(cc, &ClientConnection::frameReceived, this, &ServerManager::onClientFrame);
+    connect(cc, &ClientConnection::disconnected, this, &ServerManager::onClientDisconnected);
+    connect(cc, &ClientConnection::logMessage, this, &ServerManager::onClientLog);
+
+    {
+        QMutexLocker locker(&mutex_);
+        clients_.insert(cc->id(), cc);
+    }
+    awaitingFirstFrame_.insert(cc->id());
+
+    QJsonObject ack;
+    ack["type"] = QStringLiteral("ConnectAck");
+    ack["client_id"] = cc->id();
+    if(datagrams_->port() != 0 && !cc->isLocal()) {
+        datagrams_->allowClient(cc->id(), cc->peerAddress());
+        ack["udp_port"] = datagrams_->port();
+    }
+    cc->sendJson(ack);
+
+    emit clientConnected(cc->id(), cc->peerName(), cc->peerPort());
+    if(!upstreams_.isEmpty()) {
+        QJsonObject ev;
+        ev["type"] = QStringLiteral("ShardClientConnected");
+        ev["client_id"] = cc->id();
+        ev["ip"] = cc->peerName();
+        ev["port"] = cc->peerPort();
+        notifyUpstreams(ev);
+    }
+}
+
+void ServerManager::onShardData(ShardLink *link, const QString &clientId, const QJsonObject &obj, const QByteArray &payload) {
+    if(pipeline_->trySubmit(clientId, payload, obj)) return;
+    link->pause();
+    resumeTimer_->start();
+}
+
+void ServerManager::submitFromClient(const QString &clientId, const QByteArray &payload, const QJsonObject &obj) {
+    if(pipeline_->trySubmit(clientId, payload, obj)) return;
+    // pipeline is full: stop reading this one client rather than blocking
+    // the thread every connection is served from
+    ClientConnection *cc = nullptr;
+    {
+        QMutexLocker locker(&mutex_);
+        cc = clients_.value(clientId, nullptr);
+    }
+    if(!cc) return;
+    cc->pause();
+    pausedClients_.insert(clientId);
+    resumeTimer_->start();
+}
 
-        connect(cc, &ClientConnection::jsonReceived, this, &ServerManager::onClientJson);
-        connect(cc, &ClientConnection::disconnected, this, &ServerManager::onClientDisconnected);
-        connect(cc, &ClientConnection::logMessage, this, &ServerManager::onClientLog);
+void ServerManager::resumePaused() {
+    if(!pipeline_->hasRoom()) return;
+    resumeTimer_->stop();
+    QList<ClientConnection*> paused;
+    {
+        QMutexLocker locker(&mutex_);
+        for(const QString &id : pausedClients_) {
+            if(ClientConnection *cc = clients_.value(id, nullptr)) paused.append(cc);
+        }
+    }
+    pausedClients_.clear();
+    // a resumed input may fill the pipeline again and pause itself, restarting the timer
+    for(ClientConnection *cc : paused) cc->resume();
+    for(ShardLink *link : shards_) link->resume();
+}
 
+void ServerManager::onClientFrame(const QString &clientId, const QByteArray &payload) {
+    // control traffic from a front node, and the first frame of every
+    // connection (which may turn it into one), are handled right here
+    const bool first = awaitingFirstFrame_.remove(clientId);
+    if(!first && !upstreams_.contains(clientId)) {
+        submitFromClient(clientId, payload);
+        return;
+    }
+    QJsonDocument doc = QJsonDocument::fromJson(payload);
+    if(!doc.isObject()) {
+        emit logMessage(QStringLiteral("Received invalid JSON from %1").arg(clientId));
+        return;
+    }
+    QJsonObject obj = doc.object();
+    if(upstreams_.contains(clientId)) {
+        handleUpstreamJson(obj);
+        return;
+    }
+    if(obj.value("type").toString() == "AggregatorHello") {
+        ClientConnection *cc = nullptr;
         {
             QMutexLocker locker(&mutex_);
-            clients_.insert(cc->id(), cc);
+            cc = clients_.value(clientId, nullptr);
+            if(cc && isAllowedFront(cc)) clients_.remove(clientId);
+            else if(cc) {
+                // a device must not get everyone's telemetry or control other devices
+                emit logMessage(QStringLiteral("Refused front node from %1 (%2)").arg(cc->peerName(), clientId));
+                return;
+            }
         }
-        emit clientConnected(cc->id(), cc->peerAddress().toString(), cc->peerPort());
+        if(cc) attachUpstream(cc);
+        return;
+    }
+    submitFromClient(clientId, payload, obj);
+}
+
+void ServerManager::onPipelineMessage(const QString &clientId, const QJsonObject &obj, const QByteArray &payload,
+                                      const QVariantMap &results) {
+    emit dataReceived(clientId, obj, results);
+    if(!dataAcknowledged_) pipeline_->releaseDelivery();
+    emit frameReceived(clientId, obj, payload);
+    if(!upstreams_.isEmpty()) {
+        const QByteArray data = payload.isEmpty()
+            ? QJsonDocument(obj).toJson(QJsonDocument::Compact) : payload;
+        notifyUpstreams(ShardLink::packShardData(clientId, data));
     }
 }
 
-void ServerManager::onClientJson(const QString &clientId, const QJsonObject &obj) {
-    emit dataReceived(clientId, obj);
+void ServerManager::onPipelineRejected(const QString &clientId, const QString &reason) {
+    emit logMessage(QStringLiteral("Rejected message from %1: %2").arg(clientId, reason));
 }
 
 void ServerManager::onClientDisconnected(const QString &clientId) {
+    awaitingFirstFrame_.remove(clientId);
+    pausedClients_.remove(clientId);
+    datagrams_->removeClient(clientId);
+    if(upstreams_.remove(clientId)) {
+        emit logMessage(QStringLiteral("Front node detached: %1").arg(clientId));
+        return;
+    }
     {
         QMutexLocker locker(&mutex_);
         clients_.remove(clientId);
     }
     emit clientDisconnected(clientId);
+    if(!upstreams_.isEmpty()) {
+        QJsonObject ev;
+        ev["type"] = QStringLiteral("ShardClientDisconnected");
+        ev["client_id"] = clientId;
+        notifyUpstreams(ev);
+    }
+}
+
+void ServerManager::dataConsumed() {
+    pipeline_->releaseDelivery();
 }
 
 void ServerManager::onClientLog(const QString &msg) {
@@ -77,6 +309,12 @@ void ServerManager::onClientLog(const QString &msg) {
 }
 
 void ServerManager::sendToClient(const QString &clientId, const QJsonObject &obj) {
+    for(ShardLink *link : shards_) {
+        if(link->owns(clientId)) {
+            link->sendToClient(clientId, obj);
+            return;
+        }
+    }
     QMutexLocker locker(&mutex_);
     ClientConnection *c = clients_.value(clientId, nullptr);
     if(!c) return;
@@ -84,6 +322,9 @@ void ServerManager::sendToClient(const QString &clientId, const QJsonObject &obj
 }
 
 void ServerManager::broadcast(const QJsonObject &obj) {
+    for(ShardLink *link : shards_) {
+        link->broadcast(obj);
+    }
     QMutexLocker locker(&mutex_);
     for(auto c: clients_) {
         if(c) {
@@ -91,3 +332,84 @@ void ServerManager::broadcast(const QJsonObject &obj) {
         }
     }
 }
+
+void ServerManager::redirectToShard(QTcpSocket *sock) {
+    connect(sock, &QTcpSocket::disconnected, sock, &QTcpSocket::deleteLater);
+    ShardLink *link = pickShard();
+    if(!link) {
+        emit logMessage(QStringLiteral("No shard available for %1").arg(sock->peerAddress().toString()));
+        sock->disconnectFromHost();
+        return;
+    }
+    link->notePendingRedirect();
+    QJsonObject redirect;
+    redirect["type"] = QStringLiteral("Redirect");
+    redirect["host"] = link->host();
+    redirect["port"] = link->port();
+    sock->write(packJson(redirect));
+    // graceful close flushes the redirect before FIN
+    sock->disconnectFromHost();
+}
+
+ShardLink *ServerManager::pickShard() {
+    // least loaded live shard, round robin between equals
+    ShardLink *best = nullptr;
+    const int n = shards_.size();
+    for(int i = 0; i < n; ++i) {
+        ShardLink *link = shards_.at((nextShard_ + i) % n);
+        if(!link->isUp()) continue;
+        if(!best || link->load() < best->load()) best = link;
+    }
+    if(n > 0) nextShard_ = (nextShard_ + 1) % n;
+    return best;
+}
+
+void ServerManager::attachUpstream(ClientConnection *cc) {
+    upstreams_.insert(cc->id(), cc);
+    datagrams_->removeClient(cc->id());
+    emit clientDisconnected(cc->id());
+    emit logMessage(QStringLiteral("Front node attached: %1").arg(cc->id()));
+
+    // replay devices already connected here so the front sees the full shard
+    QMutexLocker locker(&mutex_);
+    for(auto c : clients_) {
+        if(!c) continue;
+        QJsonObject ev;
+        ev["type"] = QStringLiteral("ShardClientConnected");
+        ev["client_id"] = c->id();
+        ev["ip"] = c->peerName();
+        ev["port"] = c->peerPort();
+        cc->sendJson(ev);
+    }
+}
+
+bool ServerManager::isAllowedFront(const ClientConnection *cc) const {
+    if(cc->isLocal()) return false;
+    const QHostAddress addr = cc->peerAddress();
+    for(const QHostAddress &allowed : allowedFronts_) {
+        if(allowed.isEqual(addr, QHostAddress::TolerantConversion)) return true;
+    }
+    return false;
+}
+
+void ServerManager::handleUpstreamJson(const QJsonObject &obj) {
+    QString type = obj.value("type").toString();
+    if(type == "Broadcast") {
+        broadcast(obj.value("data").toObject());
+    }
+    else if(type == "SendTo") {
+        sendToClient(obj.value("client_id").toString(), obj.value("data").toObject());
+    }
+}
+
+void ServerManager::notifyUpstreams(const QJsonObject &obj) {
+    for(auto up : upstreams_) {
+        up->sendJson(obj);
+    }
+}
+
+void ServerManager::notifyUpstreams(const QByteArray &body) {
+    for(auto up : upstreams_) {
+        up->sendPayload(body);
+    }
+}
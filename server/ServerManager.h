@@ -1,10 +1,24 @@
 #pragma once
 #include <QObject>
 #include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QVariantMap>
 #include <QMap>
+#include <QList>
+#include <QPair>
 #include <QMutex>
+#include <QThread>
+#include <QSet>
+#include <QTimer>
 
 class ClientConnection;
+class ShardLink;
+class TelemetryPublisher;
+class MessagePipeline;
+class DatagramReceiver;
 
 class ServerManager : public QObject
 {
@@ -13,6 +27,30 @@ public:
     explicit ServerManager(quint16 port, QObject *parent = nullptr);
     ~ServerManager() override;
 
+    // front node mode: devices are redirected to these shards instead of
+    // being served here. must be called before startListening()
+    void setShards(const QList<QPair<QString, quint16>> &shards);
+    bool isFront() const { return !shardAddrs_.isEmpty(); }
+    // shard side: only these addresses may attach as front node with
+    // AggregatorHello; empty refuses all. must be called before startListening()
+    void setAllowedFronts(const QList<QHostAddress> &addrs) { allowedFronts_ = addrs; }
+    // port for external telemetry subscribers, 0 disables. before startListening()
+    void setPublishPort(quint16 port) { publishPort_ = port; }
+    // remote hosts allowed to subscribe; without any the publisher is localhost only
+    void setPublishAllowed(const QList<QHostAddress> &addrs) { publishAllowed_ = addrs; }
+    // unix domain socket name for co-located clients, empty disables. before startListening()
+    void setLocalServerName(const QString &name) { localName_ = name; }
+    // udp port for periodic telemetry, announced in ConnectAck; 0 disables. before startListening()
+    void setDatagramPort(quint16 port) { datagramPort_ = port; }
+    // register processors on pipeline()->registry() before startListening()
+    MessagePipeline *pipeline() const { return pipeline_; }
+    // set before startListening() when every dataReceived() will be answered
+    // with dataConsumed(); the pipeline then waits for a slow receiver
+    // instead of queueing for it
+    void setDataAcknowledged(bool on) { dataAcknowledged_ = on; }
+    // thread-safe
+    void dataConsumed();
+
 public slots:
     void startListening();
     void stopListening();
@@ -23,19 +61,65 @@ public slots:
 signals:
     void clientConnected(const QString &clientId, const QString &ip, quint16 port);
     void clientDisconnected(const QString &clientId);
-    void dataReceived(const QString &clientId, const QJsonObject &obj);
+    // results: what the pipeline processors attached to the message
+    void dataReceived(const QString &clientId, const QJsonObject &obj, const QVariantMap &results);
+    // same as dataReceived plus the original payload, feeds the publisher
+    void frameReceived(const QString &clientId, const QJsonObject &obj, const QByteArray &payload);
     void logMessage(const QString &msg);
+    void pipelineStats(const QString &summary);
+    void datagramLoss(const QString &clientId, quint64 received, quint64 lost, quint64 late);
 
 private slots:
     void onNewConnection();
-    void onClientJson(const QString &clientId, const QJsonObject &obj);
+    void onNewLocalConnection();
+    void onClientFrame(const QString &clientId, const QByteArray &payload);
+    void onPipelineMessage(const QString &clientId, const QJsonObject &obj, const QByteArray &payload,
+                           const QVariantMap &results);
+    void onPipelineRejected(const QString &clientId, const QString &reason);
     void onClientDisconnected(const QString &clientId);
     void onClientLog(const QString &msg);
+    void resumePaused();
 
 private:
+    void addClient(ClientConnection *cc);
+    void redirectToShard(QTcpSocket *sock);
+    ShardLink *pickShard();
+    void onShardData(ShardLink *link, const QString &clientId, const QJsonObject &obj, const QByteArray &payload);
+    void submitFromClient(const QString &clientId, const QByteArray &payload,
+                          const QJsonObject &obj = QJsonObject());
+    void attachUpstream(ClientConnection *cc);
+    bool isAllowedFront(const ClientConnection *cc) const;
+    void handleUpstreamJson(const QJsonObject &obj);
+    void notifyUpstreams(const QJsonObject &obj);
+    void notifyUpstreams(const QByteArray &body);
+
     QTcpServer *server_;
     quint16 port_;
+    QLocalServer *localServer_;
+    QString localName_;
+    DatagramReceiver *datagrams_;
+    quint16 datagramPort_;
     QMap<QString, ClientConnection*> clients_;
     QMutex mutex_;
+    MessagePipeline *pipeline_;
+    // connections whose first frame is still checked for AggregatorHello
+    QSet<QString> awaitingFirstFrame_;
+    // clients and shard links not read while the pipeline is full
+    QSet<QString> pausedClients_;
+    QTimer *resumeTimer_;
+    bool dataAcknowledged_;
+
+    // shard side: front nodes that attached with AggregatorHello
+    QMap<QString, ClientConnection*> upstreams_;
+    QList<QHostAddress> allowedFronts_;
+    // front side
+    QList<QPair<QString, quint16>> shardAddrs_;
+    QList<ShardLink*> shards_;
+    int nextShard_;
+
+    quint16 publishPort_;
+    QList<QHostAddress> publishAllowed_;
+    TelemetryPublisher *publisher_;
+    QThread *publisherThread_;
 };
 
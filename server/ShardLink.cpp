@@ -0,0 +1,161 @@
+#include "ShardLink.h"
+#include "MessageFraming.h"
+#include <QJsonDocument>
+
+ShardLink::ShardLink(const QString &host, quint16 port, QObject *parent)
+    : QObject(parent),
+    socket_(new QTcpSocket(this)),
+    host_(host),
+    port_(port),
+    pendingRedirects_(0),
+    paused_(false)
+{
+    connect(&retryTimer_, &QTimer::timeout, this, &ShardLink::tryConnect);
+    retryTimer_.setInterval(2000);
+
+    // while paused the shard is held back by tcp flow control
+    socket_->setReadBufferSize(1024 * 1024);
+    connect(socket_, &QTcpSocket::connected, this, &ShardLink::onConnected);
+    connect(socket_, &QTcpSocket::readyRead, this, &ShardLink::onReadyRead);
+    connect(socket_, &QTcpSocket::disconnected, this, &ShardLink::onDisconnected);
+    connect(socket_, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        if(!retryTimer_.isActive()) retryTimer_.start();
+    });
+}
+
+ShardLink::~ShardLink() {
+    socket_->abort();
+}
+
+void ShardLink::start() {
+    tryConnect();
+}
+
+void ShardLink::stop() {
+    retryTimer_.stop();
+    socket_->abort();
+    dropAllClients();
+}
+
+void ShardLink::tryConnect() {
+    if (socket_->state() == QAbstractSocket::ConnectedState ||
+        socket_->state() == QAbstractSocket::ConnectingState) return;
+    socket_->connectToHost(host_, port_);
+}
+
+void ShardLink::onConnected() {
+    retryTimer_.stop();
+    socket_->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    QJsonObject hello;
+    hello["type"] = QStringLiteral("AggregatorHello");
+    socket_->write(packJson(hello));
+    emit logMessage(QStringLiteral("Shard %1 connected").arg(name()));
+}
+
+static const char kShardDataPrefix[] = "{\"type\":\"ShardData\",\"client_id\":\"";
+static const char kShardDataMiddle[] = "\",\"data\":";
+
+QByteArray ShardLink::packShardData(const QString &clientId, const QByteArray &payload) {
+    const QByteArray id = clientId.toUtf8();
+    QByteArray body;
+    body.reserve(payload.size() + id.size() + 48);
+    body.append(kShardDataPrefix).append(id).append(kShardDataMiddle).append(payload).append('}');
+    return body;
+}
+
+bool ShardLink::unpackShardData(const QByteArray &body, QString &clientId, QByteArray &payload) {
+    const int prefixLen = int(sizeof(kShardDataPrefix)) - 1;
+    if(!body.startsWith(kShardDataPrefix) || !body.endsWith('}')) return false;
+    const int mid = body.indexOf(kShardDataMiddle, prefixLen);
+    if(mid < 0) return false;
+    const int dataStart = mid + int(sizeof(kShardDataMiddle)) - 1;
+    clientId = QString::fromUtf8(body.mid(prefixLen, mid - prefixLen));
+    payload = body.mid(dataStart, body.size() - dataStart - 1);
+    return true;
+}
+
+void ShardLink::onReadyRead() {
+    if(paused_) return;
+    buffer_.append(socket_->readAll());
+    QByteArray body;
+    while (!paused_ && tryExtractFrame(buffer_, body)) {
+        handleShardFrame(body);
+        if(paused_) buffer_.prepend(packFrame(body));
+    }
+}
+
+void ShardLink::resume() {
+    if(!paused_) return;
+    paused_ = false;
+    onReadyRead();
+}
+
+void ShardLink::handleShardFrame(const QByteArray &body) {
+    QString clientId;
+    QByteArray payload;
+    if(unpackShardData(body, clientId, payload)) {
+        const QJsonDocument doc = QJsonDocument::fromJson(payload);
+        if(doc.isObject()) {
+            emit dataReceived(clientId, doc.object(), payload);
+            return;
+        }
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(body);
+    if(doc.isObject()) {
+        handleShardJson(doc.object());
+    }
+    else {
+        emit logMessage(QStringLiteral("Invalid JSON from shard %1").arg(name()));
+    }
+}
+
+void ShardLink::onDisconnected() {
+    emit logMessage(QStringLiteral("Shard %1 disconnected, will retry").arg(name()));
+    buffer_.clear();
+    paused_ = false;
+    dropAllClients();
+    retryTimer_.start();
+}
+
+void ShardLink::handleShardJson(const QJsonObject &obj) {
+    QString type = obj.value("type").toString();
+    QString clientId = obj.value("client_id").toString();
+    if(type == "ShardData") {
+        // not in the spliced layout, re-encoded by the publisher if needed
+        emit dataReceived(clientId, obj.value("data").toObject(), QByteArray());
+    }
+    else if(type == "ShardClientConnected") {
+        clients_.insert(clientId);
+        if(pendingRedirects_ > 0) --pendingRedirects_;
+        emit clientConnected(clientId, obj.value("ip").toString(),
+                             static_cast<quint16>(obj.value("port").toInt()));
+    }
+    else if(type == "ShardClientDisconnected") {
+        if(clients_.remove(clientId)) emit clientDisconnected(clientId);
+    }
+}
+
+void ShardLink::dropAllClients() {
+    // shard is gone, so are its devices as far as the front is concerned
+    const QSet<QString> lost = clients_;
+    clients_.clear();
+    pendingRedirects_ = 0;
+    for(const QString &id : lost) emit clientDisconnected(id);
+}
+
+void ShardLink::broadcast(const QJsonObject &obj) {
+    if(!isUp()) return;
+    QJsonObject msg;
+    msg["type"] = QStringLiteral("Broadcast");
+    msg["data"] = obj;
+    socket_->write(packJson(msg));
+}
+
+void ShardLink::sendToClient(const QString &clientId, const QJsonObject &obj) {
+    if(!isUp()) return;
+    QJsonObject msg;
+    msg["type"] = QStringLiteral("SendTo");
+    msg["client_id"] = clientId;
+    msg["data"] = obj;
+    socket_->write(packJson(msg));
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QSet>
+
+// upstream connection from the front node to one shard process.
+// shard reports its devices and their data, front pushes broadcasts down.
+class ShardLink : public QObject {
+    Q_OBJECT
+public:
+    explicit ShardLink(const QString &host, quint16 port, QObject *parent = nullptr);
+    ~ShardLink() override;
+
+    QString host() const { return host_; }
+    quint16 port() const { return port_; }
+    QString name() const { return QStringLiteral("%1:%2").arg(host_).arg(port_); }
+    bool isUp() const { return socket_->state() == QAbstractSocket::ConnectedState; }
+
+    // devices owned by shard + redirects not yet confirmed by shard
+    int load() const { return clients_.size() + pendingRedirects_; }
+    bool owns(const QString &clientId) const { return clients_.contains(clientId); }
+    void notePendingRedirect() { ++pendingRedirects_; }
+
+    // stop reading the shard; a frame paused from within dataReceived()
+    // is kept and handed out again by resume()
+    void pause() { paused_ = true; }
+    void resume();
+    bool isPaused() const { return paused_; }
+
+    // ShardData frame body with the device payload spliced in as-is, so
+    // telemetry crosses the front without being re-encoded
+    static QByteArray packShardData(const QString &clientId, const QByteArray &payload);
+    static bool unpackShardData(const QByteArray &body, QString &clientId, QByteArray &payload);
+
+public slots:
+    void start();
+    void stop();
+    void broadcast(const QJsonObject &obj);
+    void sendToClient(const QString &clientId, const QJsonObject &obj);
+
+signals:
+    void clientConnected(const QString &clientId, const QString &ip, quint16 port);
+    void clientDisconnected(const QString &clientId);
+    void dataReceived(const QString &clientId, const QJsonObject &obj, const QByteArray &payload);
+    void logMessage(const QString &msg);
+
+private slots:
+    void tryConnect();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    void handleShardFrame(const QByteArray &body);
+    void handleShardJson(const QJsonObject &obj);
+    void dropAllClients();
+
+    QTcpSocket *socket_;
+    QString host_;
+    quint16 port_;
+    QTimer retryTimer_;
+    QByteArray buffer_;
+    QSet<QString> clients_;
+    int pendingRedirects_;
+    bool paused_;
+};
@@ -0,0 +1,209 @@
+#include "TelemetryPublisher.h"
+#include "MessageFraming.h"
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QUuid>
+
+// stop writing into the socket above this, further frames wait in our queue
+static const qint64 kSocketHighWater = 256 * 1024;
+static const int kDefaultQueue = 1024;
+static const int kMaxQueue = 65536;
+
+static QSet<QString> toSet(const QJsonValue &v) {
+    QSet<QString> out;
+    const QJsonArray arr = v.toArray();
+    for (const QJsonValue &item : arr) {
+        if (item.isString()) out.insert(item.toString());
+    }
+    return out;
+}
+
+Subscriber::Subscriber(QTcpSocket *socket, QObject *parent)
+    : QObject(parent),
+    socket_(socket),
+    subscribed_(false),
+    maxQueue_(kDefaultQueue),
+    policy_(DropOldest),
+    dropped_(0),
+    droppedReported_(0)
+{
+    socket_->setParent(this);
+    id_ = QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+    connect(socket_, &QTcpSocket::readyRead, this, &Subscriber::onReadyRead);
+    connect(socket_, &QTcpSocket::bytesWritten, this, &Subscriber::onBytesWritten);
+    connect(socket_, &QTcpSocket::disconnected, this, &Subscriber::onDisconnected);
+}
+
+Subscriber::~Subscriber() {
+    if(socket_) {
+        socket_->abort();
+    }
+}
+
+bool Subscriber::matches(const QString &clientId, const QString &type, const QString &severity) const {
+    if(!subscribed_) return false;
+    if(!types_.isEmpty() && !types_.contains(type)) return false;
+    if(!clientIds_.isEmpty() && !clientIds_.contains(clientId)) return false;
+    if(!severities_.isEmpty() && !severities_.contains(severity)) return false;
+    return true;
+}
+
+void Subscriber::push(const QByteArray &frame) {
+    if(queue_.isEmpty() && socket_->bytesToWrite() < kSocketHighWater) {
+        socket_->write(frame);
+        return;
+    }
+    if(queue_.size() >= maxQueue_) {
+        ++dropped_;
+        if(policy_ == DropNewest) return;
+        if(policy_ == Disconnect) {
+            emit logMessage(QStringLiteral("Subscriber %1 too slow, disconnecting").arg(id_));
+            socket_->abort();
+            return;
+        }
+        queue_.dequeue();
+    }
+    queue_.enqueue(frame);
+}
+
+void Subscriber::drain() {
+    while(!queue_.isEmpty() && socket_->bytesToWrite() < kSocketHighWater) {
+        socket_->write(queue_.dequeue());
+    }
+    if(queue_.isEmpty() && dropped_ != droppedReported_) {
+        // let the consumer know it has a gap
+        QJsonObject notice;
+        notice["type"] = QStringLiteral("Dropped");
+        notice["count"] = static_cast<qint64>(dropped_ - droppedReported_);
+        socket_->write(packJson(notice));
+        droppedReported_ = dropped_;
+    }
+}
+
+void Subscriber::onBytesWritten() {
+    drain();
+}
+
+void Subscriber::onReadyRead() {
+    buffer_.append(socket_->readAll());
+    QJsonDocument doc;
+    while(tryExtractOne(buffer_, doc)) {
+        QJsonObject obj = doc.object();
+        if(obj.value("type").toString() == "Subscribe") {
+            applySubscribe(obj);
+        }
+    }
+}
+
+void Subscriber::applySubscribe(const QJsonObject &obj) {
+    types_ = toSet(obj.value("types"));
+    clientIds_ = toSet(obj.value("client_ids"));
+    severities_ = toSet(obj.value("severity"));
+    maxQueue_ = qBound(1, obj.value("queue").toInt(kDefaultQueue), kMaxQueue);
+    QString drop = obj.value("drop").toString();
+    if(drop == "newest") policy_ = DropNewest;
+    else if(drop == "disconnect") policy_ = Disconnect;
+    else policy_ = DropOldest;
+    while(queue_.size() > maxQueue_) queue_.dequeue();
+    subscribed_ = true;
+
+    QJsonObject ack;
+    ack["type"] = QStringLiteral("SubscribeAck");
+    ack["subscriber_id"] = id_;
+    socket_->write(packJson(ack));
+    emit logMessage(QStringLiteral("Subscriber %1: types=%2 clients=%3 severity=%4 queue=%5")
+        .arg(id_).arg(types_.size()).arg(clientIds_.size()).arg(severities_.size()).arg(maxQueue_));
+}
+
+void Subscriber::onDisconnected() {
+    emit closed(this);
+}
+
+TelemetryPublisher::TelemetryPublisher(quint16 port, QObject *parent)
+    : QObject(parent),
+    server_(new QTcpServer(this)),
+    port_(port)
+{
+    connect(server_, &QTcpServer::newConnection, this, &TelemetryPublisher::onNewConnection);
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+    stop();
+}
+
+void TelemetryPublisher::start() {
+    if(server_->isListening()) return;
+    const QHostAddress bindAddr = allowedPeers_.isEmpty() ? QHostAddress(QHostAddress::LocalHost)
+                                                          : QHostAddress(QHostAddress::Any);
+    if(server_->listen(bindAddr, port_)) {
+        emit logMessage(QStringLiteral("Publishing telemetry on %1:%2").arg(bindAddr.toString()).arg(port_));
+    }
+    else {
+        emit logMessage(QStringLiteral("Failed to publish on port %1 : %2").arg(port_).arg(server_->errorString()));
+    }
+}
+
+void TelemetryPublisher::stop() {
+    if(server_->isListening()) {
+        server_->close();
+    }
+    for(Subscriber *sub : subscribers_) {
+        sub->disconnect(this);
+        sub->deleteLater();
+    }
+    subscribers_.clear();
+}
+
+void TelemetryPublisher::onNewConnection() {
+    while(server_->hasPendingConnections()) {
+        QTcpSocket *sock = server_->nextPendingConnection();
+        const QHostAddress peer = sock->peerAddress();
+        bool allowed = peer.isLoopback();
+        for(const QHostAddress &a : allowedPeers_) {
+            if(a.isEqual(peer, QHostAddress::TolerantConversion)) allowed = true;
+        }
+        if(!allowed) {
+            emit logMessage(QStringLiteral("Refused subscriber from %1").arg(peer.toString()));
+            sock->abort();
+            sock->deleteLater();
+            continue;
+        }
+        Subscriber *sub = new Subscriber(sock, this);
+        connect(sub, &Subscriber::closed, this, &TelemetryPublisher::onSubscriberClosed);
+        connect(sub, &Subscriber::logMessage, this, &TelemetryPublisher::logMessage);
+        subscribers_.append(sub);
+    }
+}
+
+void TelemetryPublisher::onSubscriberClosed(Subscriber *sub) {
+    subscribers_.removeOne(sub);
+    if(sub->dropped() > 0) {
+        emit logMessage(QStringLiteral("Subscriber %1 gone, dropped %2 frame(s)").arg(sub->id()).arg(sub->dropped()));
+    }
+    sub->deleteLater();
+}
+
+void TelemetryPublisher::publish(const QString &clientId, const QJsonObject &obj, const QByteArray &payload) {
+    if(subscribers_.isEmpty()) return;
+    const QString type = obj.value("type").toString();
+    const QString severity = obj.value("severity").toString();
+
+    // the envelope is spliced around the original bytes and built once,
+    // every matching subscriber gets a shared copy
+    QByteArray frame;
+    const auto subs = subscribers_;
+    for(Subscriber *sub : subs) {
+        if(!sub->matches(clientId, type, severity)) continue;
+        if(frame.isEmpty()) {
+            QByteArray body = payload.isEmpty()
+                ? QJsonDocument(obj).toJson(QJsonDocument::Compact) : payload;
+            QByteArray env;
+            env.reserve(body.size() + clientId.size() + 32);
+            env.append("{\"client_id\":\"").append(clientId.toUtf8()).append("\",\"data\":");
+            env.append(body).append('}');
+            frame = packFrame(env);
+        }
+        sub->push(frame);
+    }
+}
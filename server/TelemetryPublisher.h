@@ -0,0 +1,91 @@
+#pragma once
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QQueue>
+#include <QSet>
+#include <QList>
+
+// one external consumer on the publish port.
+// nothing is forwarded until it sends a Subscribe message:
+// {"type":"Subscribe", "types":[...], "client_ids":[...], "severity":[...],
+//  "queue": 1024, "drop": "oldest" | "newest" | "disconnect"}
+// empty or missing lists match everything. a severity filter only matches
+// messages that carry a severity (i.e. Log).
+class Subscriber : public QObject {
+    Q_OBJECT
+public:
+    enum DropPolicy { DropOldest, DropNewest, Disconnect };
+
+    explicit Subscriber(QTcpSocket *socket, QObject *parent = nullptr);
+    ~Subscriber() override;
+
+    QString id() const { return id_; }
+    bool isSubscribed() const { return subscribed_; }
+    bool matches(const QString &clientId, const QString &type, const QString &severity) const;
+    // queue one framed message, applying the drop policy when full
+    void push(const QByteArray &frame);
+    quint64 dropped() const { return dropped_; }
+
+signals:
+    void closed(Subscriber *sub);
+    void logMessage(const QString &msg);
+
+private slots:
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+
+private:
+    void applySubscribe(const QJsonObject &obj);
+    void drain();
+
+    QTcpSocket *socket_;
+    QString id_;
+    QByteArray buffer_;
+    bool subscribed_;
+    QSet<QString> types_;
+    QSet<QString> clientIds_;
+    QSet<QString> severities_;
+    QQueue<QByteArray> queue_;
+    int maxQueue_;
+    DropPolicy policy_;
+    quint64 dropped_;
+    quint64 droppedReported_;
+};
+
+// second listener that fans received telemetry out to external consumers.
+// lives in its own thread so filtering and slow consumers never touch ingest.
+// it hands out every device's data, so by default it only listens on
+// localhost; remote consumers must be listed in setAllowedPeers().
+class TelemetryPublisher : public QObject {
+    Q_OBJECT
+public:
+    explicit TelemetryPublisher(quint16 port, QObject *parent = nullptr);
+    ~TelemetryPublisher() override;
+
+    // remote addresses allowed to subscribe, before start()
+    void setAllowedPeers(const QList<QHostAddress> &addrs) { allowedPeers_ = addrs; }
+
+public slots:
+    void start();
+    void stop();
+    // payload is the original frame body; empty means encode obj here
+    void publish(const QString &clientId, const QJsonObject &obj, const QByteArray &payload);
+
+signals:
+    void logMessage(const QString &msg);
+
+private slots:
+    void onNewConnection();
+    void onSubscriberClosed(Subscriber *sub);
+
+private:
+    QTcpServer *server_;
+    quint16 port_;
+    QList<QHostAddress> allowedPeers_;
+    QList<Subscriber*> subscribers_;
+};
@@ -0,0 +1,138 @@
+#include "TimeSeriesBuffer.h"
+#include <cmath>
+
+TimeSeriesBuffer::TimeSeriesBuffer()
+    : raw_(kRawCapacity),
+    levels_(kLevels),
+    lastMs_(0),
+    total_(0)
+{
+}
+
+void TimeSeriesBuffer::append(qint64 timeMs, double value) {
+    if (total_ > 0 && timeMs < lastMs_) return;
+    lastMs_ = timeMs;
+    ++total_;
+    const float v = static_cast<float>(value);
+    const Bucket b{timeMs, timeMs, v, v, v, v};
+    raw_.push(b);
+    push(0, b);
+}
+
+void TimeSeriesBuffer::push(int level, const Bucket &b) {
+    Level &l = levels_[level];
+    if (l.openCount == 0) {
+        l.open = b;
+    } else {
+        l.open.t1 = b.t1;
+        l.open.min = qMin(l.open.min, b.min);
+        l.open.max = qMax(l.open.max, b.max);
+        l.open.last = b.last;
+    }
+    if (++l.openCount < kFanout) return;
+    l.ring.push(l.open);
+    l.openCount = 0;
+    if (level + 1 < kLevels) push(level + 1, l.open);
+}
+
+void TimeSeriesBuffer::clear() {
+    raw_.clear();
+    for (Level &l : levels_) {
+        l.ring.clear();
+        l.openCount = 0;
+    }
+    lastMs_ = 0;
+    total_ = 0;
+}
+
+qint64 TimeSeriesBuffer::firstTime() const {
+    // coarser levels reach further back
+    for (int s = sourceCount() - 1; s >= 0; --s) {
+        if (itemCount(s) > 0) return item(s, 0).t0;
+    }
+    return 0;
+}
+
+int TimeSeriesBuffer::itemCount(int source) const {
+    if (source == 0) return raw_.size();
+    const Level &l = levels_.at(source - 1);
+    return l.ring.size() + (l.openCount > 0 ? 1 : 0);
+}
+
+TimeSeriesBuffer::Bucket TimeSeriesBuffer::item(int source, int i) const {
+    if (source == 0) return raw_.at(i);
+    const Level &l = levels_.at(source - 1);
+    return i < l.ring.size() ? l.ring.at(i) : l.open;
+}
+
+int TimeSeriesBuffer::lowerBound(int source, qint64 t) const {
+    int lo = 0, hi = itemCount(source);
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (item(source, mid).t1 < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int TimeSeriesBuffer::upperBound(int source, qint64 t) const {
+    int lo = 0, hi = itemCount(source);
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (item(source, mid).t0 <= t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+QVector<ChartColumn> TimeSeriesBuffer::decimate(qint64 fromMs, qint64 toMs, int columns) const {
+    QVector<ChartColumn> out(qMax(columns, 0));
+    if (columns <= 0 || toMs <= fromMs || isEmpty()) return out;
+
+    const double msPerColumn = double(toMs - fromMs) / columns;
+    const int limit = columns * 4;
+    // time of the sample behind first/last, sources are visited newest first
+    QVector<qint64> firstAt(columns, 0);
+    QVector<qint64> lastAt(columns, 0);
+
+    auto column = [&](qint64 t) {
+        return qBound(0, static_cast<int>(std::floor((t - fromMs) / msPerColumn)), columns - 1);
+    };
+
+    qint64 hi = toMs;
+    for (int s = 0; s < sourceCount() && hi >= fromMs; ++s) {
+        if (itemCount(s) == 0) break;
+        const qint64 start = item(s, 0).t0;
+        if (start > hi) continue;
+        const int a = lowerBound(s, qMax(fromMs, start));
+        const int b = upperBound(s, hi);
+        // too dense for the screen here, let the next level draw this part
+        if (b - a > limit && s + 1 < sourceCount() && itemCount(s + 1) > 0) continue;
+
+        for (int i = a; i < b; ++i) {
+            const Bucket it = item(s, i);
+            const int c1 = column(it.t1);
+            // overlapping sources are fine, min/max does not double count
+            for (int c = column(it.t0); c <= c1; ++c) {
+                ChartColumn &col = out[c];
+                if (!col.valid) {
+                    col.valid = true;
+                    col.min = it.min;
+                    col.max = it.max;
+                    col.first = it.first;
+                    col.last = it.last;
+                    firstAt[c] = it.t0;
+                    lastAt[c] = it.t1;
+                    continue;
+                }
+                col.min = qMin(col.min, double(it.min));
+                col.max = qMax(col.max, double(it.max));
+                if (it.t0 < firstAt[c]) { col.first = it.first; firstAt[c] = it.t0; }
+                if (it.t1 > lastAt[c]) { col.last = it.last; lastAt[c] = it.t1; }
+            }
+        }
+        if (start <= fromMs) break;
+        hi = start - 1;
+    }
+    return out;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <QVector>
+#include <QtGlobal>
+
+// one pixel column of a decimated series
+struct ChartColumn {
+    bool valid = false;
+    double min = 0;
+    double max = 0;
+    double first = 0;   // value at the left edge, joins the previous column
+    double last = 0;
+};
+
+// fixed-size history of one metric. the newest samples are kept raw, older
+// ones only as min/max buckets: level 0 bucket = kFanout samples, each next
+// level = kFanout buckets of the one below. every level is a ring of the same
+// size, so memory is constant while coverage grows kFanout times per level.
+// samples must arrive in time order, older ones are ignored.
+class TimeSeriesBuffer
+{
+public:
+    static const int kRawCapacity = 2048;
+    static const int kLevelCapacity = 512;
+    static const int kFanout = 8;
+    static const int kLevels = 6;
+
+    TimeSeriesBuffer();
+
+    void append(qint64 timeMs, double value);
+    void clear();
+
+    bool isEmpty() const { return raw_.size() == 0; }
+    qint64 firstTime() const;
+    qint64 lastTime() const { return lastMs_; }
+    quint64 totalSamples() const { return total_; }
+
+    // min/max per column over [fromMs, toMs]. parts of the range are read
+    // from the finest level that has at most a few items per column there,
+    // so the cost depends on columns, not on how many samples the range holds.
+    QVector<ChartColumn> decimate(qint64 fromMs, qint64 toMs, int columns) const;
+
+private:
+    struct Bucket {
+        qint64 t0;
+        qint64 t1;
+        float min;
+        float max;
+        float first;
+        float last;
+    };
+
+    template <typename T>
+    class Ring {
+    public:
+        explicit Ring(int capacity) : data_(capacity), start_(0), size_(0) {}
+        void push(const T &v) {
+            if (size_ < data_.size()) {
+                data_[(start_ + size_++) % data_.size()] = v;
+            } else {
+                data_[start_] = v;
+                start_ = (start_ + 1) % data_.size();
+            }
+        }
+        const T &at(int i) const { return data_.at((start_ + i) % data_.size()); }
+        int size() const { return size_; }
+        void clear() { start_ = 0; size_ = 0; }
+    private:
+        QVector<T> data_;
+        int start_;
+        int size_;
+    };
+
+    struct Level {
+        Level() : ring(kLevelCapacity), openCount(0) {}
+        Ring<Bucket> ring;
+        Bucket open;      // bucket still being filled, newer than the ring
+        int openCount;
+    };
+
+    // source 0 is raw, source k + 1 is level k
+    int sourceCount() const { return kLevels + 1; }
+    int itemCount(int source) const;
+    Bucket item(int source, int i) const;
+    // first item ending at or after t
+    int lowerBound(int source, qint64 t) const;
+    // first item starting after t
+    int upperBound(int source, qint64 t) const;
+    void push(int level, const Bucket &b);
+
+    Ring<Bucket> raw_;
+    QVector<Level> levels_;
+    qint64 lastMs_;
+    quint64 total_;
+};
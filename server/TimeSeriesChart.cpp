@@ -0,0 +1,103 @@
+#include "TimeSeriesChart.h"
+#include "TimeSeriesBuffer.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QElapsedTimer>
+#include <QDateTime>
+
+TimeSeriesChart::TimeSeriesChart(QWidget *parent)
+    : QWidget(parent),
+    series_(nullptr),
+    spanMs_(60 * 1000),
+    refreshTimer_(this)
+{
+    setMinimumHeight(120);
+    // new samples keep coming, redraw at a fixed rate instead of per sample
+    refreshTimer_.setInterval(100);
+    connect(&refreshTimer_, &QTimer::timeout, this, [this] {
+        if (isVisible()) update();
+    });
+    refreshTimer_.start();
+}
+
+void TimeSeriesChart::setSeries(const TimeSeriesBuffer *series, const QString &title) {
+    series_ = series;
+    title_ = title;
+    update();
+}
+
+void TimeSeriesChart::setSpan(qint64 spanMs) {
+    spanMs_ = spanMs;
+    update();
+}
+
+void TimeSeriesChart::paintEvent(QPaintEvent *) {
+    QPainter p(this);
+    p.fillRect(rect(), palette().base());
+    p.setPen(palette().text().color());
+
+    if (!series_ || series_->isEmpty()) {
+        p.drawText(rect(), Qt::AlignCenter, title_.isEmpty() ? QStringLiteral("No data") : title_ + QStringLiteral(": no data"));
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QFontMetrics fm = p.fontMetrics();
+    const int margin = 4;
+    const QRect plot = rect().adjusted(fm.horizontalAdvance(QStringLiteral("00000.0")) + margin,
+                                       fm.height() + margin, -margin, -fm.height() - margin);
+    if (plot.width() < 2 || plot.height() < 2) return;
+
+    const qint64 toMs = series_->lastTime();
+    const qint64 fromMs = spanMs_ > 0 ? toMs - spanMs_ : series_->firstTime();
+    const QVector<ChartColumn> cols = series_->decimate(fromMs, qMax(toMs, fromMs + 1), plot.width());
+
+    double lo = 0, hi = 0;
+    bool any = false;
+    for (const ChartColumn &c : cols) {
+        if (!c.valid) continue;
+        lo = any ? qMin(lo, c.min) : c.min;
+        hi = any ? qMax(hi, c.max) : c.max;
+        any = true;
+    }
+    if (hi - lo < 1e-9) { lo -= 1; hi += 1; }
+    auto y = [&](double v) {
+        return plot.bottom() - (v - lo) / (hi - lo) * (plot.height() - 1);
+    };
+
+    p.setPen(palette().mid().color());
+    p.drawRect(plot.adjusted(0, 0, -1, -1));
+
+    // a vertical stroke per column, joined to the neighbour where both have data
+    QPainterPath path;
+    bool prevValid = false;
+    for (int i = 0; i < cols.size(); ++i) {
+        const ChartColumn &c = cols.at(i);
+        if (!c.valid) { prevValid = false; continue; }
+        const double x = plot.left() + i + 0.5;
+        if (prevValid) path.lineTo(x, y(c.first));
+        else path.moveTo(x, y(c.first));
+        path.moveTo(x, y(c.min));
+        path.lineTo(x, y(c.max));
+        path.moveTo(x, y(c.last));
+        prevValid = true;
+    }
+    p.setPen(QPen(palette().highlight().color(), 1));
+    p.drawPath(path);
+
+    p.setPen(palette().text().color());
+    const int labelWidth = plot.left() - margin;
+    p.drawText(QRect(0, plot.top() - fm.height() / 2, labelWidth, fm.height()),
+               Qt::AlignRight | Qt::AlignVCenter, QString::number(hi, 'f', 1));
+    p.drawText(QRect(0, plot.bottom() - fm.height() / 2, labelWidth, fm.height()),
+               Qt::AlignRight | Qt::AlignVCenter, QString::number(lo, 'f', 1));
+    const QRect bottom(plot.left(), plot.bottom() + margin, plot.width(), fm.height());
+    p.drawText(bottom, Qt::AlignLeft, QDateTime::fromMSecsSinceEpoch(fromMs).time().toString());
+    p.drawText(bottom, Qt::AlignRight, QDateTime::fromMSecsSinceEpoch(toMs).time().toString());
+    p.drawText(QRect(plot.left(), 0, plot.width(), fm.height()), Qt::AlignLeft,
+               QStringLiteral("%1, %2 samples").arg(title_).arg(series_->totalSamples()));
+    p.drawText(QRect(plot.left(), 0, plot.width(), fm.height()), Qt::AlignRight,
+               QStringLiteral("%1 ms").arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2));
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <QWidget>
+#include <QTimer>
+
+class TimeSeriesBuffer;
+
+// live line chart of one TimeSeriesBuffer. the visible window ends at the
+// newest sample; each repaint asks the buffer for one min/max column per pixel.
+class TimeSeriesChart : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TimeSeriesChart(QWidget *parent = nullptr);
+
+    // buffer is not owned, pass nullptr before deleting it
+    void setSeries(const TimeSeriesBuffer *series, const QString &title);
+    // 0 shows everything the buffer still holds
+    void setSpan(qint64 spanMs);
+
+    QSize sizeHint() const override { return QSize(600, 200); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    const TimeSeriesBuffer *series_;
+    QString title_;
+    qint64 spanMs_;
+    QTimer refreshTimer_;
+};
@@ -1,11 +1,115 @@
-#include "mainwindow.h"
+#include "MainWindow.h"
+#include "ServerManager.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QDebug>
+#include <cstring>
+
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) return true;
+    }
+    return false;
+}
+
+// "host:port,host:port" -> list, bad entries are skipped
+static QList<QPair<QString, quint16>> parseShards(const QString &spec)
+{
+    QList<QPair<QString, quint16>> out;
+    for (const QString &item : spec.split(',', Qt::SkipEmptyParts)) {
+        int colon = item.lastIndexOf(':');
+        bool ok = false;
+        quint16 port = colon > 0 ? item.mid(colon + 1).toUShort(&ok) : 0;
+        if (!ok) {
+            qWarning() << "Ignoring bad shard address" << item;
+            continue;
+        }
+        out.append({item.left(colon).trimmed(), port});
+    }
+    return out;
+}
+
+static QList<QHostAddress> parseAddresses(const QString &spec)
+{
+    QList<QHostAddress> out;
+    for (const QString &item : spec.split(',', Qt::SkipEmptyParts)) {
+        QHostAddress addr(item.trimmed());
+        if (addr.isNull()) {
+            qWarning() << "Ignoring bad address" << item;
+            continue;
+        }
+        out.append(addr);
+    }
+    return out;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // shard processes have no GUI, so no display is needed for them
+    const bool headless = isHeadless(argc, argv);
+    QScopedPointer<QCoreApplication> app(headless ? new QCoreApplication(argc, argv)
+                                                  : new QApplication(argc, argv));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption portOpt("port", "Listen port.", "port", "12345");
+    QCommandLineOption headlessOpt("headless", "Run without GUI (shard process).");
+    QCommandLineOption pubOpt("pub-port", "Port for telemetry subscribers, 0 disables (default 12346 with GUI, off headless).", "port");
+    QCommandLineOption pubAllowOpt("pub-allow", "Remote hosts allowed to subscribe, addr[,addr...]; without it only localhost.", "list");
+    QCommandLineOption localOpt("local", "Unix domain socket name for co-located clients, empty disables (default tt-server with GUI, off headless).", "name");
+    QCommandLineOption udpOpt("udp-port", "UDP port for periodic telemetry, 0 disables (default 12347 with GUI, off headless).", "port");
+    QCommandLineOption frontOpt("front", "Shard: addresses allowed to attach as front node, addr[,addr...].", "list");
+    QCommandLineOption shardsOpt("shards", "Run as front node over shards host:port[,host:port...].", "list");
+    parser.addOption(portOpt);
+    parser.addOption(headlessOpt);
+    parser.addOption(pubOpt);
+    parser.addOption(pubAllowOpt);
+    parser.addOption(localOpt);
+    parser.addOption(udpOpt);
+    parser.addOption(shardsOpt);
+    parser.addOption(frontOpt);
+    parser.process(*app);
+
+    const quint16 port = parser.value(portOpt).toUShort();
+    const auto shards = parseShards(parser.value(shardsOpt));
+    const auto fronts = parseAddresses(parser.value(frontOpt));
+    const auto pubAllowed = parseAddresses(parser.value(pubAllowOpt));
+    const quint16 pubPort = parser.isSet(pubOpt) ? parser.value(pubOpt).toUShort()
+                                                 : (headless ? 0 : 12346);
+    const QString localName = parser.isSet(localOpt) ? parser.value(localOpt)
+                                                     : (headless ? QString() : QStringLiteral("tt-server"));
+    const quint16 udpPort = parser.isSet(udpOpt) ? parser.value(udpOpt).toUShort()
+                                                 : (headless ? 0 : 12347);
+
+    if (headless) {
+        ServerManager manager(port);
+        manager.setShards(shards);
+        manager.setAllowedFronts(fronts);
+        manager.setPublishPort(pubPort);
+        manager.setPublishAllowed(pubAllowed);
+        manager.setLocalServerName(localName);
+        manager.setDatagramPort(udpPort);
+        QObject::connect(&manager, &ServerManager::logMessage, [](const QString &msg) {
+            qInfo().noquote() << msg;
+        });
+        QObject::connect(&manager, &ServerManager::pipelineStats, [](const QString &summary) {
+            qInfo().noquote() << "pipeline:" << summary;
+        });
+        manager.startListening();
+        return app->exec();
+    }
+
     MainWindow w;
+    w.setListenPort(port);
+    w.setShards(shards);
+    w.setAllowedFronts(fronts);
+    w.setPublishPort(pubPort);
+    w.setPublishAllowed(pubAllowed);
+    w.setLocalServerName(localName);
+    w.setDatagramPort(udpPort);
     w.show();
-    return a.exec();
+    return app->exec();
 }